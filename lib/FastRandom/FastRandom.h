@@ -0,0 +1,71 @@
+#ifndef FAST_RANDOM_H
+#define FAST_RANDOM_H
+
+#include <stdint.h>
+
+// Small xorshift32 generator for hot paths.
+//
+// Arduino's random() goes through a shared, locked generator and a modulo. Give each task its
+// own FastRandom instead: nothing is shared between cores, and a fixed seed makes a run
+// repeatable (the native tests rely on that).
+class FastRandom
+{
+public:
+  explicit FastRandom(uint32_t seed = 1)
+  {
+    setSeed(seed);
+  }
+
+  // xorshift can't leave the all zero state, so a seed of 0 is replaced with 1.
+  void setSeed(uint32_t seed)
+  {
+    state = seed != 0 ? seed : 1;
+    bits = 0;
+    bitCount = 0;
+  }
+
+  uint32_t next()
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  // Returns a value in [0, howBig), using a multiply and shift instead of a modulo.
+  uint32_t nextBelow(uint32_t howBig)
+  {
+    return (uint32_t)(((uint64_t)next() * howBig) >> 32);
+  }
+
+  // Returns a value in [howSmall, howBig), like Arduino's random(howSmall, howBig).
+  int32_t nextRange(int32_t howSmall, int32_t howBig)
+  {
+    if (howSmall >= howBig)
+      return howSmall;
+
+    return howSmall + (int32_t)nextBelow((uint32_t)(howBig - howSmall));
+  }
+
+  // One random bit, taken from a buffered word, so 32 calls cost one next().
+  bool nextBit()
+  {
+    if (bitCount == 0)
+    {
+      bits = next();
+      bitCount = 32;
+    }
+
+    bool bit = bits & 1;
+    bits >>= 1;
+    bitCount--;
+    return bit;
+  }
+
+private:
+  uint32_t state;
+  uint32_t bits;
+  uint8_t bitCount;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef SAND_CHUNKS_H
+#define SAND_CHUNKS_H
+
+#include <stdint.h>
+#include <algorithm>
+
+// The most tasks that can move pixels at the same time (one per core on the ESP32).
+static const uint8_t SAND_MAX_WORKERS = 2;
+
+// Bounding rect of the cells in a chunk that need updating. minX > maxX means the chunk is
+// asleep.
+struct SandChunkRect
+{
+  int16_t minX;
+  int16_t minY;
+  int16_t maxX;
+  int16_t maxY;
+
+  bool isAwake() const
+  {
+    return minX <= maxX;
+  }
+
+  void reset()
+  {
+    minX = minY = INT16_MAX;
+    maxX = maxY = INT16_MIN;
+  }
+
+  void include(int16_t x, int16_t y)
+  {
+    minX = std::min(minX, x);
+    minY = std::min(minY, y);
+    maxX = std::max(maxX, x);
+    maxY = std::max(maxY, y);
+  }
+
+  void include(const SandChunkRect &other)
+  {
+    if (!other.isAwake())
+      return;
+
+    include(other.minX, other.minY);
+    include(other.maxX, other.maxY);
+  }
+};
+
+// Tracks which chunks of CHUNK_COLS x CHUNK_ROWS cells are awake, so a frame only visits the
+// parts of the grid where something can still move.
+//
+// The rects for the frame being updated are only read while pixels move. Cells that need
+// updating next frame are marked in a separate table per worker, so workers on different cores
+// never write to the same rect, and beginFrame() merges them.
+template <int16_t COLS, int16_t ROWS, int16_t CHUNK_COLS, int16_t CHUNK_ROWS>
+class SandChunks
+{
+public:
+  static const int16_t CHUNKS_X = (COLS + CHUNK_COLS - 1) / CHUNK_COLS;
+  static const int16_t CHUNKS_Y = (ROWS + CHUNK_ROWS - 1) / CHUNK_ROWS;
+
+  void clear()
+  {
+    for (int16_t i = 0; i < CHUNKS_X * CHUNKS_Y; i++)
+    {
+      current[i].reset();
+      for (uint8_t worker = 0; worker < SAND_MAX_WORKERS; worker++)
+        next[worker][i].reset();
+    }
+  }
+
+  // Makes the cells marked during the last frame the ones to update in this frame.
+  void beginFrame()
+  {
+    for (int16_t i = 0; i < CHUNKS_X * CHUNKS_Y; i++)
+    {
+      current[i].reset();
+      for (uint8_t worker = 0; worker < SAND_MAX_WORKERS; worker++)
+      {
+        current[i].include(next[worker][i]);
+        next[worker][i].reset();
+      }
+    }
+  }
+
+  const SandChunkRect &get(int16_t chunkX, int16_t chunkY) const
+  {
+    return current[chunkY * CHUNKS_X + chunkX];
+  }
+
+  // Wakes the chunk holding (x, y) for the next frame.
+  void mark(uint8_t worker, int16_t x, int16_t y)
+  {
+    next[worker][(y / CHUNK_ROWS) * CHUNKS_X + x / CHUNK_COLS].include(x, y);
+  }
+
+private:
+  SandChunkRect current[CHUNKS_X * CHUNKS_Y];
+  SandChunkRect next[SAND_MAX_WORKERS][CHUNKS_X * CHUNKS_Y];
+};
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef SAND_ENGINE_H
+#define SAND_ENGINE_H
+
+#include <stdint.h>
+#include "SandGrid.h"
+#include "SandChunks.h"
+#include "FastRandom.h"
+#include "SandProfile.h"
+
+// The falling sand simulation shared by the sand projects. It has no dependency on the display,
+// the Arduino core or FreeRTOS, so it also builds for the native benchmark (see test/).
+//
+// Each task moving pixels passes in its own FastRandom, for the left/right choice when a pixel
+// can't fall straight down.
+
+// Receives every pixel the engine moves. Projects draw to their display from here.
+class SandDrawSink
+{
+public:
+  virtual ~SandDrawSink() {}
+
+  virtual void drawCell(int16_t x, int16_t y, uint16_t color, uint8_t aux) = 0;
+  virtual void clearCell(int16_t x, int16_t y) = 0;
+};
+
+// COLOR_T is the color type stored per pixel, see SandGrid.h. Draw sinks get it as a uint16_t.
+template <int16_t COLS, int16_t ROWS, typename COLOR_T = uint16_t>
+class SandEngine
+{
+public:
+  typedef SandGrid<COLS, ROWS, COLOR_T> Grid;
+
+  // Width of the column stripes used by moveStripes(). A pixel moves at most one column
+  // sideways per frame, so stripes at least 2 columns wide keep two stripes that are being
+  // updated at the same time from ever touching the same column.
+  static const int16_t STRIPE_COLS = 16;
+  static const int16_t STRIPES = (COLS + STRIPE_COLS - 1) / STRIPE_COLS;
+  static_assert(STRIPE_COLS >= 2, "Stripes must be at least 2 columns wide");
+
+  // Only awake chunks are visited each frame. Chunks are as wide as a stripe, so a stripe is one
+  // column of chunks.
+  static const int16_t CHUNK_COLS = STRIPE_COLS;
+  static const int16_t CHUNK_ROWS = 16;
+  typedef SandChunks<COLS, ROWS, CHUNK_COLS, CHUNK_ROWS> Chunks;
+
+  SandEngine(SandDrawSink &drawSink, uint8_t gravity = 1)
+      : drawSink(drawSink), gravity(gravity)
+  {
+  }
+
+  // Call once at startup.
+  bool begin()
+  {
+    frameStamp = 0;
+    chunks.clear();
+    return grid.begin();
+  }
+
+  Grid &getGrid()
+  {
+    return grid;
+  }
+
+  // Adds a new pixel at (x, y) and draws it. Returns false if the cell is taken or out of bounds.
+  bool spawn(int16_t x, int16_t y, COLOR_T color, uint8_t aux = 0)
+  {
+    if (!grid.isEmpty(x, y))
+      return false;
+
+    grid.place(x, y, GRID_STATE_NEW, color, 1, aux, frameStamp);
+    chunks.mark(0, x, y);
+    drawSink.drawCell(x, y, color, aux);
+    return true;
+  }
+
+  // Call once per frame, after spawning and before the movePixels() or moveStripes() calls for
+  // that frame. Those calls must cover every column once per frame, or the pixels left out fall
+  // asleep.
+  void beginFrame()
+  {
+    frameStamp ^= GRID_STAMP_BIT;
+    chunks.beginFrame();
+  }
+
+  // Returns the lowest row (highest Y) in [fromYRow, toYRow] of the column where a pixel could go,
+  // or -1 if there is none. Slots must be free and above the landed pixels in the column.
+  int16_t findPixelSlot(int16_t xCol, int16_t fromYRow, int16_t toYRow) const
+  {
+    if (!Grid::withinCols(xCol))
+      return -1;
+
+    return grid.findLowestEmptyRow(xCol, fromYRow, std::min<int16_t>(toYRow, grid.getColumnTop(xCol) - 1));
+  }
+
+  void updateLandedPixelsColumnTops(int16_t xCol, int16_t yRow)
+  {
+    // The grid stores the highest row (Y) where a pixel stopped for each column (X).
+    grid.land(xCol, yRow);
+  }
+
+  bool canPixelFall(int16_t pixelXCol, int16_t pixelYRow) const
+  {
+    int16_t pixelYRowNext = pixelYRow + 1;
+
+    if (!Grid::withinRows(pixelYRowNext))
+      return false;
+
+    int16_t pixelXColMinus = pixelXCol - 1;
+    int16_t pixelXColPlus = pixelXCol + 1;
+
+    return (Grid::withinCols(pixelXColMinus) && grid.getColumnTop(pixelXColMinus) > pixelYRowNext) ||
+           (Grid::withinCols(pixelXCol) && grid.getColumnTop(pixelXCol) > pixelYRowNext) ||
+           (Grid::withinCols(pixelXColPlus) && grid.getColumnTop(pixelXColPlus) > pixelYRowNext);
+  }
+
+  // Moves the pixels in one phase of a frame split between several workers (tasks on different
+  // cores), without any locking.
+  //
+  // The columns are split into stripes of STRIPE_COLS. Phase 0 updates the even stripes and
+  // phase 1 the odd ones, so the stripes updated at the same time always have an idle stripe
+  // between them. Within a phase, each worker takes every workerCount-th of those stripes.
+  // All workers must finish phase 0 before any of them starts phase 1. workerCount can be at
+  // most SAND_MAX_WORKERS.
+  void moveStripes(uint8_t phase, uint8_t worker, uint8_t workerCount, FastRandom &random)
+  {
+    for (int16_t stripe = phase + 2 * worker; stripe < STRIPES; stripe += 2 * workerCount)
+    {
+      int16_t xColBegin = stripe * STRIPE_COLS;
+      movePixels(xColBegin, std::min<int16_t>(xColBegin + STRIPE_COLS, COLS), random, worker);
+    }
+  }
+
+  // Move the pixels in columns [_xColBegin, _xColEnd) as needed. Pixels at the edges may move
+  // one column outside the range, so only one task may call this at a time, unless the ranges
+  // come from moveStripes().
+  //
+  // Only the cells marked awake in the last frame are visited. Landed pixels never move again,
+  // so a chunk stays awake only while it holds pixels that are still falling, and a pixel that
+  // falls into a neighbouring chunk wakes that chunk up.
+  void movePixels(int16_t _xColBegin, int16_t _xColEnd, FastRandom &random, uint8_t worker = 0)
+  {
+    SAND_PROFILE_SCOPE(SAND_TIMER_MOVE);
+
+    int16_t chunkXBegin = _xColBegin / CHUNK_COLS;
+    int16_t chunkXEnd = (_xColEnd + CHUNK_COLS - 1) / CHUNK_COLS;
+
+    // Go bottom up, so pixels mostly move into rows that were already visited this frame.
+    for (int16_t pixelYRow = ROWS - 1; pixelYRow >= 0; pixelYRow--)
+    {
+      int16_t chunkY = pixelYRow / CHUNK_ROWS;
+
+      for (int16_t chunkX = chunkXBegin; chunkX < chunkXEnd; chunkX++)
+      {
+        const SandChunkRect &rect = chunks.get(chunkX, chunkY);
+        if (pixelYRow < rect.minY || pixelYRow > rect.maxY)
+          continue;
+
+        int16_t xColBegin = std::max(_xColBegin, rect.minX);
+        int16_t xColEnd = std::min<int16_t>(_xColEnd, rect.maxX + 1);
+        SAND_PROFILE_COUNT(SAND_COUNT_CELLS_VISITED, std::max(xColEnd - xColBegin, 0));
+
+        for (int16_t pixelXCol = xColBegin; pixelXCol < xColEnd; pixelXCol++)
+          movePixel(pixelXCol, pixelYRow, random, worker);
+      }
+    }
+  }
+
+  // Number of pixels that have not landed yet. Walks the whole grid, so keep it out of hot paths.
+  uint32_t countLivePixels() const
+  {
+    uint32_t count = 0;
+
+    for (int16_t yRow = 0; yRow < ROWS; yRow++)
+    {
+      for (int16_t xCol = 0; xCol < COLS; xCol++)
+      {
+        auto state = grid.getState(xCol, yRow);
+        if (state == GRID_STATE_NEW || state == GRID_STATE_FALLING)
+          count++;
+      }
+    }
+
+    return count;
+  }
+
+private:
+  void movePixel(int16_t pixelXCol, int16_t pixelYRow, FastRandom &random, uint8_t worker)
+  {
+    auto pixelState = grid.getState(pixelXCol, pixelYRow);
+    if (pixelState != GRID_STATE_NEW && pixelState != GRID_STATE_FALLING)
+      return;
+
+    // Skip pixels that were already moved here this frame.
+    if (!grid.stamp(pixelXCol, pixelYRow, frameStamp))
+      return;
+
+    if (pixelState == GRID_STATE_NEW)
+    {
+      grid.setState(pixelXCol, pixelYRow, GRID_STATE_FALLING);
+      chunks.mark(worker, pixelXCol, pixelYRow);
+      return;
+    }
+
+    uint8_t velocity = grid.getVelocity(pixelXCol, pixelYRow);
+
+    // The pixel goes to the lowest free slot it can reach this frame, straight down or one
+    // column to either side. The slots in between don't need to be free.
+    int16_t fromYRow = pixelYRow + 1;
+    int16_t toYRow = std::min<int16_t>(pixelYRow + velocity, ROWS - 1);
+
+    SAND_PROFILE_COUNT(SAND_COUNT_SLOT_LOOKUPS, 3);
+
+    int16_t newXCol = pixelXCol;
+    int16_t newYRow = findPixelSlot(pixelXCol, fromYRow, toYRow);
+
+    int16_t leftYRow = findPixelSlot(pixelXCol - 1, fromYRow, toYRow);
+    int16_t rightYRow = findPixelSlot(pixelXCol + 1, fromYRow, toYRow);
+    int16_t sideYRow = std::max(leftYRow, rightYRow);
+
+    // Straight down wins a tie, and left or right is picked at random when they tie.
+    if (sideYRow > newYRow)
+    {
+      if (leftYRow == rightYRow)
+        newXCol = random.nextBit() ? pixelXCol - 1 : pixelXCol + 1;
+      else
+        newXCol = leftYRow > rightYRow ? pixelXCol - 1 : pixelXCol + 1;
+
+      newYRow = sideYRow;
+    }
+
+    if (newYRow != -1)
+    {
+      grid.move(pixelXCol, pixelYRow, newXCol, newYRow, velocity + gravity, frameStamp);
+      chunks.mark(worker, newXCol, newYRow);
+
+      // Out with the old, in with the new.
+      drawSink.clearCell(pixelXCol, pixelYRow);
+      drawSink.drawCell(newXCol, newYRow, grid.getColor(newXCol, newYRow), grid.getAux(newXCol, newYRow));
+      return;
+    }
+
+    if (canPixelFall(pixelXCol, pixelYRow))
+    {
+      // Blocked for now, try again next frame.
+      chunks.mark(worker, pixelXCol, pixelYRow);
+    }
+    else
+    {
+      updateLandedPixelsColumnTops(pixelXCol, pixelYRow);
+    }
+  }
+
+  Grid grid;
+  Chunks chunks;
+  SandDrawSink &drawSink;
+  uint8_t gravity;
+
+  // Parity of the current frame, stamped onto each cell as it is updated. See SandGrid.h.
+  uint8_t frameStamp = 0;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef SAND_GRID_H
+#define SAND_GRID_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+static const uint8_t GRID_STATE_EMPTY = 0;
+static const uint8_t GRID_STATE_NEW = 1;
+static const uint8_t GRID_STATE_FALLING = 2;
+static const uint8_t GRID_STATE_LANDED = 3;
+
+// The top bit of a cell's state byte holds the parity of the frame that last updated it, so a
+// pixel that was moved into a cell is not moved a second time in the same frame.
+static const uint8_t GRID_STATE_MASK = 0x7F;
+static const uint8_t GRID_STAMP_BIT = 0x80;
+
+// Flat store for the scaled sand grid.
+//
+// Every cell has one state byte, and the color, velocity and aux byte of the pixel in it are kept
+// in separate arrays. All of them are indexed by (y * COLS + x), so looking up a cell is an array
+// read instead of a hash lookup, and moving a pixel updates it in place without allocating. A
+// pixel that is blocked only touches its state and velocity bytes.
+//
+// COLOR_T is whatever the project draws with: an RGB565 color, or an index into a palette (see
+// SandPalette.h) to save memory.
+//
+// Aux is not used by the engine; projects can keep per-pixel extras in it (e.g. a shape or a
+// color cycle state) and it moves along with the pixel.
+//
+// For each column (X), the grid also tracks the highest row (Y) where a pixel stopped, and which
+// rows are occupied as packed bit words, so the lowest free row in a range of a column can be
+// found a word at a time with a count leading zeros.
+template <int16_t COLS, int16_t ROWS, typename COLOR_T = uint16_t>
+class SandGrid
+{
+public:
+  static const int16_t COLUMN_WORDS = (ROWS + 31) / 32;
+
+  SandGrid() {}
+
+  ~SandGrid()
+  {
+    free(states);
+    free(colors);
+    free(velocities);
+    free(auxes);
+  }
+
+  // The grid owns its cell arrays, so it can't be copied.
+  SandGrid(const SandGrid &) = delete;
+  SandGrid &operator=(const SandGrid &) = delete;
+
+  // Allocates the cell arrays and clears the grid. Call at startup, before any other method.
+  // Calling it again reuses the arrays that were already allocated.
+  bool begin()
+  {
+    if (states == NULL)
+      states = (uint8_t *)malloc(COLS * ROWS * sizeof(uint8_t));
+    if (colors == NULL)
+      colors = (COLOR_T *)malloc(COLS * ROWS * sizeof(COLOR_T));
+    if (velocities == NULL)
+      velocities = (uint8_t *)malloc(COLS * ROWS * sizeof(uint8_t));
+    if (auxes == NULL)
+      auxes = (uint8_t *)malloc(COLS * ROWS * sizeof(uint8_t));
+
+    if (states == NULL || colors == NULL || velocities == NULL || auxes == NULL)
+      return false;
+
+    clear();
+    return true;
+  }
+
+  void clear()
+  {
+    memset(states, GRID_STATE_EMPTY, COLS * ROWS * sizeof(uint8_t));
+    memset(occupied, 0, sizeof(occupied));
+
+    // Set the tallest pixel column to be 1 slot bellow the "bottom" (0,0 coordinate being top left.)
+    for (int16_t xCol = 0; xCol < COLS; xCol++)
+      columnTops[xCol] = ROWS;
+  }
+
+  static bool withinCols(int16_t x)
+  {
+    return x >= 0 && x < COLS;
+  }
+
+  static bool withinRows(int16_t y)
+  {
+    return y >= 0 && y < ROWS;
+  }
+
+  uint8_t getState(int16_t x, int16_t y) const
+  {
+    return states[index(x, y)] & GRID_STATE_MASK;
+  }
+
+  void setState(int16_t x, int16_t y, uint8_t state)
+  {
+    uint8_t &cell = states[index(x, y)];
+    cell = (cell & GRID_STAMP_BIT) | state;
+  }
+
+  // False for out of bounds cells, so callers don't need a separate bounds check.
+  bool isEmpty(int16_t x, int16_t y) const
+  {
+    return withinCols(x) && withinRows(y) && getState(x, y) == GRID_STATE_EMPTY;
+  }
+
+  COLOR_T getColor(int16_t x, int16_t y) const
+  {
+    return colors[index(x, y)];
+  }
+
+  void setColor(int16_t x, int16_t y, COLOR_T color)
+  {
+    colors[index(x, y)] = color;
+  }
+
+  uint8_t getVelocity(int16_t x, int16_t y) const
+  {
+    return velocities[index(x, y)];
+  }
+
+  uint8_t getAux(int16_t x, int16_t y) const
+  {
+    return auxes[index(x, y)];
+  }
+
+  void setAux(int16_t x, int16_t y, uint8_t aux)
+  {
+    auxes[index(x, y)] = aux;
+  }
+
+  uint16_t getColumnTop(int16_t x) const
+  {
+    return columnTops[x];
+  }
+
+  // Returns the lowest free row (highest Y) in [fromY, toY] of column x, or -1 if they are all
+  // taken. Looks at 32 rows per step, so the cost hardly depends on the size of the range.
+  int16_t findLowestEmptyRow(int16_t x, int16_t fromY, int16_t toY) const
+  {
+    if (fromY > toY)
+      return -1;
+
+    const uint32_t *column = occupied[x];
+
+    for (int16_t word = toY >> 5; word >= (fromY >> 5); word--)
+    {
+      uint32_t empty = ~column[word];
+
+      // Drop the rows past either end of the range.
+      int16_t wordFirstY = word << 5;
+      if (toY - wordFirstY < 31)
+        empty &= (2u << (toY - wordFirstY)) - 1;
+      if (fromY > wordFirstY)
+        empty &= ~((1u << (fromY - wordFirstY)) - 1);
+
+      if (empty != 0)
+        return wordFirstY + 31 - __builtin_clz(empty);
+    }
+
+    return -1;
+  }
+
+  // Marks the cell as visited in the frame with the given parity. Returns false if it already was.
+  bool stamp(int16_t x, int16_t y, uint8_t frameStamp)
+  {
+    uint8_t &cell = states[index(x, y)];
+
+    if ((cell & GRID_STAMP_BIT) == frameStamp)
+      return false;
+
+    cell = (cell & GRID_STATE_MASK) | frameStamp;
+    return true;
+  }
+
+  void place(int16_t x, int16_t y, uint8_t state, COLOR_T color, uint8_t velocity, uint8_t aux, uint8_t frameStamp)
+  {
+    uint32_t i = index(x, y);
+    states[i] = state | frameStamp;
+    setOccupied(x, y);
+    colors[i] = color;
+    velocities[i] = velocity;
+    auxes[i] = aux;
+  }
+
+  void move(int16_t fromX, int16_t fromY, int16_t toX, int16_t toY, uint8_t velocity, uint8_t frameStamp)
+  {
+    uint32_t from = index(fromX, fromY);
+    uint32_t to = index(toX, toY);
+
+    states[to] = (states[from] & GRID_STATE_MASK) | frameStamp;
+    colors[to] = colors[from];
+    velocities[to] = velocity;
+    auxes[to] = auxes[from];
+
+    states[from] = GRID_STATE_EMPTY;
+
+    clearOccupied(fromX, fromY);
+    setOccupied(toX, toY);
+  }
+
+  // The pixel stays where it is, but no longer falls.
+  void land(int16_t x, int16_t y)
+  {
+    setState(x, y, GRID_STATE_LANDED);
+    columnTops[x] = std::min(columnTops[x], (uint16_t)y);
+  }
+
+private:
+  static uint32_t index(int16_t x, int16_t y)
+  {
+    return (uint32_t)y * COLS + x;
+  }
+
+  void setOccupied(int16_t x, int16_t y)
+  {
+    occupied[x][y >> 5] |= 1u << (y & 31);
+  }
+
+  void clearOccupied(int16_t x, int16_t y)
+  {
+    occupied[x][y >> 5] &= ~(1u << (y & 31));
+  }
+
+  uint8_t *states = NULL;
+  COLOR_T *colors = NULL;
+  uint8_t *velocities = NULL;
+  uint8_t *auxes = NULL;
+  uint16_t columnTops[COLS];
+
+  // Bit (y & 31) of occupied[x][y >> 5] is set while a pixel is in the cell at (x, y).
+  uint32_t occupied[COLS][COLUMN_WORDS];
+};
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef SAND_PROFILE_H
+#define SAND_PROFILE_H
+
+// Optional instrumentation for the sand projects.
+//
+// Define SAND_PROFILE before including anything from the sand libraries (a project does it at the
+// top of its main.cpp) to record, per core, how long each part of a frame takes, how long tasks
+// sit blocked on semaphores, and how much work the engine does. SAND_PROFILE_REPORT() then prints
+// averages per frame to Serial, like stats_routine in the fluid-simulation project, and keeps a
+// short version for an on-screen overlay. Without SAND_PROFILE every macro compiles to nothing.
+//
+// Timers may nest: on the 4.3 inch board the sink calls made from movePixels() time
+// SAND_TIMER_WAIT_DISPLAY and SAND_TIMER_DRAW inside SAND_TIMER_MOVE, and spawning or recoloring
+// can draw too. Every timer reports self time, with the nested timers' time taken out.
+
+#ifdef SAND_PROFILE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+enum SandProfileTimer
+{
+  SAND_TIMER_SPAWN,        // Adding pixels under the brush.
+  SAND_TIMER_MOVE,         // SandEngine::movePixels().
+  SAND_TIMER_DRAW,         // Sending pixels to the display.
+  SAND_TIMER_COLOR_CHANGE, // Recoloring pixels already on screen.
+  SAND_TIMER_WAIT_PHASE,   // Blocked until the other core finishes its part of a phase.
+  SAND_TIMER_WAIT_DISPLAY, // Blocked on the display mutex.
+  SAND_TIMER_COUNT
+};
+
+enum SandProfileCounter
+{
+  SAND_COUNT_CELLS_VISITED, // Cells movePixels() looked at.
+  SAND_COUNT_SLOT_LOOKUPS,  // Columns searched for a free slot.
+  SAND_COUNT_COUNT
+};
+
+static const uint8_t SAND_PROFILE_CORES = 2;
+
+struct SandProfileStats
+{
+  uint32_t micros[SAND_PROFILE_CORES][SAND_TIMER_COUNT];
+  uint32_t counts[SAND_PROFILE_CORES][SAND_COUNT_COUNT];
+  // Time spent in scopes nested inside the innermost open scope on each core.
+  uint32_t nestedMicros[SAND_PROFILE_CORES];
+  uint32_t frames;
+  unsigned long periodStartMillis;
+  char overlay[64];
+};
+
+inline SandProfileStats &sandProfileStats()
+{
+  static SandProfileStats stats;
+  return stats;
+}
+
+inline uint32_t sandProfileNowMicros()
+{
+#ifdef ARDUINO
+  return micros();
+#else
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Each core only writes its own row of the stats, so no lock is needed.
+inline uint8_t sandProfileCore()
+{
+#ifdef ARDUINO
+  return xPortGetCoreID();
+#else
+  return 0;
+#endif
+}
+
+// Adds the time from construction to destruction to a timer, minus the time spent in scopes
+// nested inside it, so no microsecond is counted under two timers.
+class SandProfileScope
+{
+public:
+  explicit SandProfileScope(SandProfileTimer timer) : timer(timer), core(sandProfileCore())
+  {
+    uint32_t &nested = sandProfileStats().nestedMicros[core];
+    outerNested = nested;
+    nested = 0;
+    start = sandProfileNowMicros();
+  }
+
+  ~SandProfileScope()
+  {
+    SandProfileStats &stats = sandProfileStats();
+    uint32_t elapsed = sandProfileNowMicros() - start;
+    stats.micros[core][timer] += elapsed - stats.nestedMicros[core];
+    stats.nestedMicros[core] = outerNested + elapsed;
+  }
+
+private:
+  SandProfileTimer timer;
+  uint8_t core;
+  uint32_t start;
+  uint32_t outerNested;
+};
+
+#ifdef ARDUINO
+// Counts a frame, and every periodMs prints the averages per frame since the last report to
+// Serial, refreshes the overlay text and starts over.
+inline void sandProfileReport(unsigned long periodMs)
+{
+  SandProfileStats &stats = sandProfileStats();
+  stats.frames++;
+
+  unsigned long now = millis();
+  unsigned long elapsed = now - stats.periodStartMillis;
+  if (elapsed < periodMs)
+    return;
+
+  uint32_t frames = stats.frames;
+  uint32_t perFrame[SAND_PROFILE_CORES][SAND_TIMER_COUNT];
+  for (uint8_t core = 0; core < SAND_PROFILE_CORES; core++)
+    for (uint8_t timer = 0; timer < SAND_TIMER_COUNT; timer++)
+      perFrame[core][timer] = stats.micros[core][timer] / frames;
+
+  Serial.printf("FPS: %.1f, us/frame (core 0 | core 1): spawn %u | %u, move %u | %u, draw %u | %u, color %u | %u, "
+                "phase wait %u | %u, display wait %u | %u, cells/frame %u | %u, slot lookups/frame %u | %u, "
+                "heap max used: %u / %u, psram max used: %u / %u\n",
+                frames * 1000.0 / elapsed,
+                perFrame[0][SAND_TIMER_SPAWN], perFrame[1][SAND_TIMER_SPAWN],
+                perFrame[0][SAND_TIMER_MOVE], perFrame[1][SAND_TIMER_MOVE],
+                perFrame[0][SAND_TIMER_DRAW], perFrame[1][SAND_TIMER_DRAW],
+                perFrame[0][SAND_TIMER_COLOR_CHANGE], perFrame[1][SAND_TIMER_COLOR_CHANGE],
+                perFrame[0][SAND_TIMER_WAIT_PHASE], perFrame[1][SAND_TIMER_WAIT_PHASE],
+                perFrame[0][SAND_TIMER_WAIT_DISPLAY], perFrame[1][SAND_TIMER_WAIT_DISPLAY],
+                stats.counts[0][SAND_COUNT_CELLS_VISITED] / frames, stats.counts[1][SAND_COUNT_CELLS_VISITED] / frames,
+                stats.counts[0][SAND_COUNT_SLOT_LOOKUPS] / frames, stats.counts[1][SAND_COUNT_SLOT_LOOKUPS] / frames,
+                ESP.getHeapSize() - ESP.getMinFreeHeap(), ESP.getHeapSize(),
+                ESP.getPsramSize() - ESP.getMinFreePsram(), ESP.getPsramSize());
+
+  snprintf(stats.overlay, sizeof(stats.overlay), "mv %5u|%5u dr %5u wt %5u",
+           perFrame[0][SAND_TIMER_MOVE], perFrame[1][SAND_TIMER_MOVE],
+           perFrame[0][SAND_TIMER_DRAW] + perFrame[1][SAND_TIMER_DRAW],
+           perFrame[1][SAND_TIMER_WAIT_PHASE] + perFrame[1][SAND_TIMER_WAIT_DISPLAY]);
+
+  memset(stats.micros, 0, sizeof(stats.micros));
+  memset(stats.counts, 0, sizeof(stats.counts));
+  stats.frames = 0;
+  stats.periodStartMillis = now;
+}
+#else
+// The host has no Serial or display to report to, so this only counts the frame. The totals stay
+// in sandProfileStats() for a test or benchmark to read.
+inline void sandProfileReport(unsigned long)
+{
+  sandProfileStats().frames++;
+}
+#endif
+
+#define SAND_PROFILE_JOIN2(a, b) a##b
+#define SAND_PROFILE_JOIN(a, b) SAND_PROFILE_JOIN2(a, b)
+
+// Times the rest of the enclosing block.
+#define SAND_PROFILE_SCOPE(timer) SandProfileScope SAND_PROFILE_JOIN(sandProfileScope, __LINE__)(timer)
+#define SAND_PROFILE_COUNT(counter, n) (sandProfileStats().counts[sandProfileCore()][counter] += (n))
+#define SAND_PROFILE_REPORT(periodMs) sandProfileReport(periodMs)
+// Short text for drawing on screen, updated with each report.
+#define SAND_PROFILE_OVERLAY() (sandProfileStats().overlay)
+
+#else
+
+#define SAND_PROFILE_SCOPE(timer)
+#define SAND_PROFILE_COUNT(counter, n)
+#define SAND_PROFILE_REPORT(periodMs)
+
+#endif
+
+#endif
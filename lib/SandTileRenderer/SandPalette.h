@@ -0,0 +1,86 @@
+#ifndef SAND_PALETTE_H
+#define SAND_PALETTE_H
+
+#include <stdint.h>
+
+// 256 RGB565 colors for sand grids that store a 1 byte palette index per pixel.
+//
+// The palette can be rotated: index i then shows the color of entry i + rotation, so every pixel
+// changes color without touching the grid.
+class SandPalette
+{
+public:
+  static const uint16_t SIZE = 256;
+
+  // Fills the palette with the color cycle the sand projects step the pixel color through:
+  // red, yellow, green, cyan, blue, magenta and back to red, spread evenly over the entries.
+  // Entries that would match backgroundColor are nudged off it, so pixels never disappear.
+  void fillColorCycle(uint16_t backgroundColor)
+  {
+    for (uint16_t i = 0; i < SIZE; i++)
+    {
+      // Six ramps. up is how far along its ramp entry i is, from 0 to 255.
+      uint8_t ramp = i * 6 / SIZE;
+      uint8_t up = (i * 6) % SIZE;
+      uint8_t down = 255 - up;
+
+      uint8_t red = 0, green = 0, blue = 0;
+      switch (ramp)
+      {
+      case 0:
+        red = 255, green = up;
+        break;
+      case 1:
+        red = down, green = 255;
+        break;
+      case 2:
+        green = 255, blue = up;
+        break;
+      case 3:
+        green = down, blue = 255;
+        break;
+      case 4:
+        red = up, blue = 255;
+        break;
+      case 5:
+        red = 255, blue = down;
+        break;
+      }
+
+      uint16_t color = (red >> 3) << 11 | (green >> 2) << 5 | (blue >> 3);
+      if (color == backgroundColor)
+        color++;
+
+      colors[i] = color;
+    }
+
+    rotation = 0;
+  }
+
+  uint16_t get(uint8_t index) const
+  {
+    return colors[(uint8_t)(index + rotation)];
+  }
+
+  // The color of index at some other rotation.
+  uint16_t get(uint8_t index, uint8_t atRotation) const
+  {
+    return colors[(uint8_t)(index + atRotation)];
+  }
+
+  uint8_t getRotation() const
+  {
+    return rotation;
+  }
+
+  void rotate(int8_t steps)
+  {
+    rotation += steps;
+  }
+
+private:
+  uint16_t colors[SIZE];
+  uint8_t rotation = 0;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef SAND_TILE_RENDERER_H
+#define SAND_TILE_RENDERER_H
+
+#include <TFT_eSPI.h>
+#include "SandEngine.h"
+#include "SandPalette.h"
+
+// Draws a sand grid to a TFT_eSPI display in tiles.
+//
+// As a SandDrawSink it only marks the tile under each changed cell as dirty, which is cheap
+// enough to do from both cores without a lock. flush() then packs every dirty tile from the
+// grid into an off-screen sprite and sends it with one DMA transfer, instead of one SPI
+// transaction per native pixel. Two sprites are used so the next tile can be packed while the
+// previous one is still being sent, like draw_routine in the fluid-simulation project.
+//
+// TILE_COLS x TILE_ROWS is the tile size in grid cells and must divide the grid evenly.
+// COLOR_T is the grid's color type: RGB565 colors as they are, or uint8_t indexes into a
+// SandPalette.
+template <int16_t COLS, int16_t ROWS, int8_t PIXEL_WIDTH, int16_t TILE_COLS, int16_t TILE_ROWS, typename COLOR_T = uint16_t>
+class SandTileRenderer : public SandDrawSink
+{
+public:
+  static_assert(COLS % TILE_COLS == 0 && ROWS % TILE_ROWS == 0, "Tiles must divide the grid evenly");
+
+  static const int16_t TILES_X = COLS / TILE_COLS;
+  static const int16_t TILES_Y = ROWS / TILE_ROWS;
+  static const int16_t TILE_WIDTH = TILE_COLS * PIXEL_WIDTH;   // In native pixels.
+  static const int16_t TILE_HEIGHT = TILE_ROWS * PIXEL_WIDTH; // In native pixels.
+
+  typedef SandGrid<COLS, ROWS, COLOR_T> Grid;
+
+  // The palette is required when COLOR_T is uint8_t.
+  SandTileRenderer(TFT_eSPI &tft, uint16_t backgroundColor, SandPalette *palette = NULL)
+      : tft(tft), backgroundColor(backgroundColor), palette(palette), tiles{TFT_eSprite(&tft), TFT_eSprite(&tft)}
+  {
+  }
+
+  // Call from setup(), after tft.init(). The grid is the one the renderer is the draw sink for.
+  bool begin(const Grid &sandGrid)
+  {
+    grid = &sandGrid;
+
+    for (int i = 0; i < 2; i++)
+    {
+      if (tiles[i].createSprite(TILE_WIDTH, TILE_HEIGHT) == NULL)
+        return false;
+    }
+
+    tft.initDMA();
+    markAllDirty();
+    return true;
+  }
+
+  void drawCell(int16_t x, int16_t y, uint16_t color, uint8_t aux) override
+  {
+    markDirty(x, y);
+  }
+
+  void clearCell(int16_t x, int16_t y) override
+  {
+    markDirty(x, y);
+  }
+
+  void markDirty(int16_t x, int16_t y)
+  {
+    dirtyTiles[(y / TILE_ROWS) * TILES_X + (x / TILE_COLS)] = 1;
+  }
+
+  void markAllDirty()
+  {
+    memset(dirtyTiles, 1, sizeof(dirtyTiles));
+  }
+
+  // Rotates the palette and marks the tiles where a pixel's color changed because of it. Pixels
+  // keep their palette index, so the grid isn't touched. Call between frames, not while pixels
+  // are moving.
+  void rotatePalette(int8_t steps)
+  {
+    uint8_t oldRotation = palette->getRotation();
+    palette->rotate(steps);
+
+    for (int16_t tileY = 0; tileY < TILES_Y; tileY++)
+    {
+      for (int16_t tileX = 0; tileX < TILES_X; tileX++)
+      {
+        uint8_t &dirty = dirtyTiles[tileY * TILES_X + tileX];
+        if (!dirty)
+          dirty = hasColorChanged(tileX * TILE_COLS, tileY * TILE_ROWS, oldRotation);
+      }
+    }
+  }
+
+  // Sends every dirty tile to the display. Call once per frame, after all the pixels have moved.
+  // Returns the number of tiles sent.
+  uint16_t flush()
+  {
+    uint16_t sent = 0;
+
+    tft.startWrite(); // start a single transfer for all the tiles
+
+    for (int16_t tileY = 0; tileY < TILES_Y; tileY++)
+    {
+      for (int16_t tileX = 0; tileX < TILES_X; tileX++)
+      {
+        uint8_t &dirty = dirtyTiles[tileY * TILES_X + tileX];
+        if (!dirty)
+          continue;
+
+        dirty = 0;
+
+        uint16_t *buffer = (uint16_t *)tiles[writeTile].getPointer();
+        packTile(tileX * TILE_COLS, tileY * TILE_ROWS, buffer);
+
+        // pushImageDMA also spin-waits until the previous transfer is done
+        tft.pushImageDMA(tileX * TILE_WIDTH, tileY * TILE_HEIGHT, TILE_WIDTH, TILE_HEIGHT, buffer);
+
+        writeTile ^= 1;
+        sent++;
+      }
+    }
+
+    // Let the last transfer finish, so the caller can draw to the display directly again.
+    tft.dmaWait();
+    tft.endWrite();
+
+    return sent;
+  }
+
+private:
+  // The sprite buffers hold colors in the byte order the display expects, so swap them here.
+  static uint16_t swapBytes(uint16_t color)
+  {
+    return (color >> 8) | (color << 8);
+  }
+
+  uint16_t resolveColor(uint16_t color) const
+  {
+    return color;
+  }
+
+  uint16_t resolveColor(uint8_t index) const
+  {
+    return palette->get(index);
+  }
+
+  bool hasColorChanged(int16_t xColStart, int16_t yRowStart, uint8_t oldRotation) const
+  {
+    for (int16_t y = yRowStart; y < yRowStart + TILE_ROWS; y++)
+    {
+      for (int16_t x = xColStart; x < xColStart + TILE_COLS; x++)
+      {
+        if (grid->getState(x, y) == GRID_STATE_EMPTY)
+          continue;
+
+        uint8_t index = grid->getColor(x, y);
+        if (palette->get(index, oldRotation) != palette->get(index))
+          return true;
+      }
+    }
+
+    return false;
+  }
+
+  void packTile(int16_t xColStart, int16_t yRowStart, uint16_t *buffer) const
+  {
+    uint16_t background = swapBytes(backgroundColor);
+
+    for (int16_t yRow = 0; yRow < TILE_ROWS; yRow++)
+    {
+      uint16_t *line = buffer + yRow * PIXEL_WIDTH * TILE_WIDTH;
+      uint16_t *out = line;
+
+      for (int16_t xCol = 0; xCol < TILE_COLS; xCol++)
+      {
+        int16_t x = xColStart + xCol;
+        int16_t y = yRowStart + yRow;
+        uint16_t color = grid->getState(x, y) == GRID_STATE_EMPTY ? background : swapBytes(resolveColor(grid->getColor(x, y)));
+
+        for (int8_t i = 0; i < PIXEL_WIDTH; i++)
+          *out++ = color;
+      }
+
+      // The rest of the native rows for this grid row are the same as the first.
+      for (int8_t j = 1; j < PIXEL_WIDTH; j++)
+        memcpy(line + j * TILE_WIDTH, line, TILE_WIDTH * sizeof(uint16_t));
+    }
+  }
+
+  TFT_eSPI &tft;
+  const Grid *grid = NULL;
+  uint16_t backgroundColor;
+  SandPalette *palette;
+
+  TFT_eSprite tiles[2]; // we'll use the two tiles for double-buffering
+  uint8_t writeTile = 0;
+
+  uint8_t dirtyTiles[TILES_X * TILES_Y];
+};
+
+#endif
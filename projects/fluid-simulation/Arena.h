@@ -0,0 +1,108 @@
+// Arena
+// One block of memory from one region (like DRAM, IRAM, or PSRAM), reserved once at boot, that
+//  fields are then placed in one after the other. Nothing in it is freed until the whole arena is,
+//  so it can't fragment, and with every region reserved up front, where a field ends up no longer
+//  depends on what happened to be allocated before it.
+// On the ESP32 the block comes from heap_caps_malloc with the capabilities of the region, and
+//  anywhere else (like the native tests) from plain malloc. If the region doesn't have the room
+//  (or doesn't exist, like PSRAM on a board without it), the arena is just empty, and allocate()
+//  returns NULL for the caller to fall back on the ordinary heap.
+// A region's free memory is often split into blocks smaller than everything planned for it, so 
+//  arenas can be chained, and a chain is then used like one arena: each allocation goes in the 
+//  first arena of the chain it fits in.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifdef ESP32
+#include <esp_heap_caps.h>
+#endif
+
+#define ARENA_ALIGN 8 // bytes, which every allocation is aligned to and rounded up to
+
+class Arena{
+    public:
+        const char *name;
+
+        Arena(const char *name, size_t size, uint32_t caps = 0);
+        ~Arena();
+        // An arena owns its block, so a copy would free it a second time
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        // How much of an arena count T's take, for adding up how big to make it
+        template<class T>
+        static size_t bytes(int count){ return (count*sizeof(T)+ARENA_ALIGN-1)/ARENA_ALIGN*ARENA_ALIGN; }
+
+        // count default-constructed T's, in the first arena of the chain they fit in, or NULL (counted 
+        //  as a miss) if they don't fit in any. They're never destructed, so T shouldn't need to be.
+        template<class T>
+        T* allocate(int count);
+
+        // Adds an arena to the end of this one's chain, which then owns it
+        void chain(Arena *arena);
+        Arena* next() const { return this->_next; }
+
+        bool reserved() const { return this->_base != NULL; }
+        const void* base() const { return this->_base; }
+        size_t size() const { return this->_size; }
+        size_t used() const { return this->_used; }
+        size_t headroom() const { return this->_size-this->_used; }
+        int misses() const { return this->_misses; }
+    private:
+        uint8_t *_base;
+        size_t _size, _used;
+        int _misses;
+        Arena *_next;
+};
+
+inline Arena::Arena(const char *name, size_t size, uint32_t caps){
+    this->name = name;
+    #ifdef ESP32
+    this->_base = (size > 0)? (uint8_t*)heap_caps_malloc(size, caps) : NULL;
+    #else
+    (void)caps; // the host has only the one heap
+    this->_base = (size > 0)? (uint8_t*)malloc(size) : NULL;
+    #endif
+    this->_size = (this->_base != NULL)? size : 0;
+    this->_used = 0;
+    this->_misses = 0;
+    this->_next = NULL;
+}
+
+inline Arena::~Arena(){
+    #ifdef ESP32
+    heap_caps_free(this->_base);
+    #else
+    free(this->_base);
+    #endif
+    delete this->_next;
+}
+
+inline void Arena::chain(Arena *arena){
+    Arena *last = this;
+    while(last->_next != NULL) last = last->_next;
+    last->_next = arena;
+}
+
+template<class T>
+T* Arena::allocate(int count){
+    size_t bytes = Arena::bytes<T>(count);
+    if(bytes > this->headroom()){
+        if(this->_next != NULL) return this->_next->allocate<T>(count);
+        this->_misses++; // so a miss is counted on the last arena of a chain
+        return NULL;
+    }
+
+    T *allocated = reinterpret_cast<T*>(this->_base+this->_used);
+    for(int k = 0; k < count; k++) new(&allocated[k]) T();
+    this->_used += bytes;
+    return allocated;
+}
+
+#endif
@@ -0,0 +1,101 @@
+// Backtrace
+// Where the fluid in each cell came from, found once by trace() and then used by apply() to advect
+//  any number of fields by the same velocity, like the three color fields. Each cell keeps the 
+//  offset of the cell at the lower-left of its source and the interpolation weights in 1/256ths, 
+//  which is all semilagrangian_advect would otherwise work out again for every field. That's 4 
+//  bytes per cell, and it limits the fields to 65536 elements including the boundary.
+// apply() gives the same result as semilagrangian_advect for Fixed fields with 8 fractional bits 
+//  (the weights get cut down to that anyway), and is within 1/256 of a weight for floats.
+
+#ifndef BACKTRACE_H
+#define BACKTRACE_H
+
+#include <cstdint>
+
+#include "Field.h"
+#include "VectorField.h"
+#include "operations.h"
+
+class Backtrace{
+    public:
+        Backtrace(int N_i, int N_j, Arena *arena = NULL); // the samples go in the arena, if given
+        ~Backtrace();
+
+        // How much of an arena the samples for an N_i by N_j grid take
+        static size_t storage_bytes(int N_i, int N_j){ return Arena::bytes<sample>(N_i*N_j); }
+
+        template<class COORD_T, int NI, int NJ>
+        void trace(const VectorField<COORD_T, NI, NJ> *velocity, float dt);
+
+        // property and new_property must have the shape the velocity had
+        template<class T, int NI, int NJ>
+        void apply(Field<T, NI, NJ> *new_property, const Field<T, NI, NJ> *property) const;
+    private:
+        struct sample{
+            uint16_t offset; // of the lower-left cell, in the Field's data()
+            uint8_t di, dj;
+        };
+
+        int _N_i, _N_j;
+        sample *_samples; // row by row, without the boundary
+        bool _owns_samples; // if not, they're in an arena
+};
+
+inline Backtrace::Backtrace(int N_i, int N_j, Arena *arena){
+    this->_N_i = N_i;
+    this->_N_j = N_j;
+    this->_samples = (arena != NULL)? arena->allocate<sample>(N_i*N_j) : NULL;
+    this->_owns_samples = (this->_samples == NULL);
+    if(this->_owns_samples) this->_samples = new sample[N_i*N_j];
+}
+
+inline Backtrace::~Backtrace(){
+    if(this->_owns_samples) delete[] this->_samples;
+}
+
+template<class COORD_T, int NI, int NJ>
+void Backtrace::trace(const VectorField<COORD_T, NI, NJ> *velocity, float dt){
+    int N_i = this->_N_i, N_j = this->_N_j;
+    const COORD_T dt_coord = dt, max_i = N_i-0.5f, max_j = N_j-0.5f;
+    const COORD_T *u = velocity->x.data(), *v = velocity->y.data();
+    sample *samples = this->_samples;
+    parallel_for(0, N_i, [&](int i_begin, int i_end){
+        for(int i = i_begin; i < i_end; i++){
+            int row = velocity->x.offset(i, 0);
+            for(int j = 0; j < N_j; j++){
+                int k = row+j, i11, j11;
+                COORD_T di, dj;
+                backtrace(i, j, u[k], v[k], dt_coord, max_i, max_j, i11, j11, di, dj);
+
+                sample &s = samples[i*N_j+j];
+                s.offset = velocity->x.offset(i11, j11);
+                s.di = weight_to_byte(di);
+                s.dj = weight_to_byte(dj);
+            }
+        }
+    });
+}
+
+template<class T, int NI, int NJ>
+void Backtrace::apply(Field<T, NI, NJ> *new_property, const Field<T, NI, NJ> *property) const{
+    typedef typename interp_weight<T>::type WEIGHT_T;
+
+    int N_i = this->_N_i, N_j = this->_N_j, stride = property->row_stride();
+    const sample *samples = this->_samples;
+    const T *p = property->data();
+    T *new_p = new_property->data();
+    parallel_for(0, N_i, [&](int i_begin, int i_end){
+        for(int i = i_begin; i < i_end; i++){
+            int row = new_property->offset(i, 0);
+            for(int j = 0; j < N_j; j++){
+                const sample &s = samples[i*N_j+j];
+                new_p[row+j] = billinear_interpolate(
+                    weight_from_byte<WEIGHT_T>::convert(s.di), weight_from_byte<WEIGHT_T>::convert(s.dj),
+                    p[s.offset], p[s.offset+1], p[s.offset+stride], p[s.offset+stride+1]);
+            }
+        }
+    });
+    new_property->update_boundary();
+}
+
+#endif
@@ -0,0 +1,31 @@
+// DoubleBuffer
+// Two fields of the same shape, for operations that can't write over their input (like advection).
+//  Write the back from the front, then swap() makes the result the front. Swapping only exchanges
+//  the memory of the two, so no values are copied, nothing is allocated after construction, and
+//  pointers to front() and back() stay valid. FIELD_T is a Field or a VectorField.
+
+#ifndef DOUBLE_BUFFER_H
+#define DOUBLE_BUFFER_H
+
+#include "Field.h"
+
+template<class FIELD_T>
+class DoubleBuffer{
+    public:
+        DoubleBuffer(int N_i, int N_j, BoundaryCondition bc, Arena *arena = NULL) 
+            : _front(N_i, N_j, bc, arena), _back(N_i, N_j, bc, arena) {}
+        // Only for a fixed-size FIELD_T
+        explicit DoubleBuffer(BoundaryCondition bc, Arena *arena = NULL) 
+            : _front(bc, arena), _back(bc, arena) {}
+
+        FIELD_T* front(){ return &this->_front; }
+        const FIELD_T* front() const{ return &this->_front; }
+        FIELD_T* back(){ return &this->_back; }
+        const FIELD_T* back() const{ return &this->_back; }
+
+        void swap(){ this->_front.swap(this->_back); }
+    private:
+        FIELD_T _front, _back;
+};
+
+#endif
@@ -1,100 +1,188 @@
 #ifndef FIELD_H
 #define FIELD_H
 
+#include <cassert>
 #include <sstream>
 #include <iomanip>
+#include <utility>
+
+#include "Arena.h"
 
 enum BoundaryCondition {DONTCARE, CLONE, NEGATIVE};
 
-template<class T>
-class Field{
+// The shape of a Field. Given NI and NJ, N_i and N_j are compile-time constants, so the offsets 
+//  and row strides in every loop over the Field are too. With the default of 0 for both, they're 
+//  set at runtime instead, which is what the tests and the coarse grids of Multigrid use.
+template<int NI, int NJ>
+struct FieldShape{
+    static constexpr int N_i = NI, N_j = NJ;
+
+    FieldShape(int N_i = NI, int N_j = NJ){
+        assert(N_i == NI && N_j == NJ); // the storage is laid out for NI by NJ, so nothing else fits
+        (void)N_i; (void)N_j;
+    }
+    void swap(FieldShape &) {}
+    void clear() {}
+};
+
+template<int NI, int NJ> constexpr int FieldShape<NI, NJ>::N_i;
+template<int NI, int NJ> constexpr int FieldShape<NI, NJ>::N_j;
+
+template<>
+struct FieldShape<0, 0>{
+    int N_i, N_j;
+
+    FieldShape(int N_i, int N_j) : N_i(N_i), N_j(N_j) {}
+    void swap(FieldShape &rhs){
+        std::swap(this->N_i, rhs.N_i);
+        std::swap(this->N_j, rhs.N_j);
+    }
+    void clear(){ this->N_i = this->N_j = 0; }
+};
+
+// Field<T> has its shape set at runtime, and Field<T, NI, NJ> has it fixed (see FieldShape)
+template<class T, int NI = 0, int NJ = 0>
+class Field : public FieldShape<NI, NJ>{
     public:
-        int N_i, N_j;
+        // the number of elements in data(), including the boundary, for declaring storage for a 
+        //  fixed-size Field
+        static constexpr int STORAGE_ELEMS = (NI+2)*(NJ+2);
+
         BoundaryCondition bc;
 
-        Field(int N_i, int N_j, BoundaryCondition bc);
+        // N_i and N_j must be NI and NJ if given, which is asserted. The memory comes from the arena if 
+        //  one is given and it has the room, or else from the heap.
+        Field(int N_i, int N_j, BoundaryCondition bc, Arena *arena = NULL);
+        // Only for fixed-size Fields. The first gets the memory like above, and the second uses the 
+        //  given STORAGE_ELEMS elements without ever freeing them, so they can be a static array in 
+        //  whatever memory region it was declared in.
+        explicit Field(BoundaryCondition bc, Arena *arena = NULL);
+        Field(T *storage, BoundaryCondition bc);
+        Field(Field &&rhs); // takes over the memory of rhs, which is left empty
         ~Field();
 
         // Boundary exists at i = -1, i = N_i, j = -1, j = N_j
         T& index(int i, int j);
         T index(int i, int j) const;
+        // Where (i, j) is in data(), which is the same for every Field of the same shape. Moving 
+        //  one row up is + row_stride().
+        int offset(int i, int j) const { return 1+(i+1)*(this->N_j+2)+j; }
+        int row_stride() const { return this->N_j+2; }
+        T* data() { return this->_arr; }
+        const T* data() const { return this->_arr; }
         void update_boundary(); // Make sure to call this after updating values!
+        // Just the boundary at j = -1 and j = N_j on row i, for operations that go row by row and need 
+        //  a row's boundary before they're done with the rest
+        void update_side_boundary(int i);
         
         Field& operator=(const T *rhs);
         Field& operator=(const Field &rhs);
+        Field& operator=(Field &&rhs);
+        void swap(Field &rhs); // exchanges the memory (and shape and bc) instead of copying values
 
         std::string toString(int precision = -1, bool inside_only = true) const;
     private:
         T *_arr;
-        int _inside_elems, _total_elems;
+        bool _owns_arr; // if not, the memory was given to the constructor or is in an arena
 };
 
-template<class T>
-Field<T>::Field(int N_i, int N_j, BoundaryCondition bc){
-    this->N_i = N_i;
-    this->N_j = N_j;
-    this->_inside_elems = N_i*N_j;
-    this->_total_elems = (N_i+2)*(N_j+2);
-    this->_arr = new T[_total_elems];
+template<class T, int NI, int NJ>
+constexpr int Field<T, NI, NJ>::STORAGE_ELEMS;
+
+template<class T, int NI, int NJ>
+Field<T, NI, NJ>::Field(int N_i, int N_j, BoundaryCondition bc, Arena *arena) : FieldShape<NI, NJ>(N_i, N_j){
+    int elems = (this->N_i+2)*(this->N_j+2);
+    this->_arr = (arena != NULL)? arena->allocate<T>(elems) : NULL;
+    this->_owns_arr = (this->_arr == NULL);
+    if(this->_owns_arr) this->_arr = new T[elems];
     this->bc = bc;
 }
 
-template<class T>
-Field<T>::~Field(){
-    delete[] this->_arr;
+template<class T, int NI, int NJ>
+Field<T, NI, NJ>::Field(BoundaryCondition bc, Arena *arena) : Field(NI, NJ, bc, arena){
+    static_assert(NI > 0 && NJ > 0, "only a fixed-size Field knows its shape");
 }
 
-template<class T>
-T& Field<T>::index(int i, int j){
-    return this->_arr[1+(i+1)*(this->N_j+2)+j];
+template<class T, int NI, int NJ>
+Field<T, NI, NJ>::Field(T *storage, BoundaryCondition bc) : FieldShape<NI, NJ>(NI, NJ){
+    static_assert(NI > 0 && NJ > 0, "only a fixed-size Field knows its shape");
+    this->_arr = storage;
+    this->_owns_arr = false;
+    this->bc = bc;
+}
+
+template<class T, int NI, int NJ>
+Field<T, NI, NJ>::Field(Field &&rhs) : FieldShape<NI, NJ>(rhs){
+    this->_arr = rhs._arr;
+    this->_owns_arr = rhs._owns_arr;
+    this->bc = rhs.bc;
+
+    rhs.clear();
+    rhs._arr = nullptr;
 }
 
-template<class T>
-T Field<T>::index(int i, int j) const{
-    return this->_arr[1+(i+1)*(this->N_j+2)+j];
+template<class T, int NI, int NJ>
+Field<T, NI, NJ>::~Field(){
+    if(this->_owns_arr) delete[] this->_arr;
 }
 
-template<class T>
-void Field<T>::update_boundary(){
+template<class T, int NI, int NJ>
+T& Field<T, NI, NJ>::index(int i, int j){
+    return this->_arr[this->offset(i, j)];
+}
+
+template<class T, int NI, int NJ>
+T Field<T, NI, NJ>::index(int i, int j) const{
+    return this->_arr[this->offset(i, j)];
+}
+
+template<class T, int NI, int NJ>
+void Field<T, NI, NJ>::update_side_boundary(int i){
+    if(this->bc == CLONE){
+        this->index(i, -1) = this->index(i, 0);
+        this->index(i, this->N_j) = this->index(i, this->N_j-1);
+    }
+    else if(this->bc == NEGATIVE){
+        this->index(i, -1) = -this->index(i, 0);
+        this->index(i, this->N_j) = -this->index(i, this->N_j-1);
+    }
+}
+
+template<class T, int NI, int NJ>
+void Field<T, NI, NJ>::update_boundary(){
     if(this->bc == DONTCARE) return;
     else if(this->bc == CLONE){
         // corners
         this->index(-1, -1) = this->index(0, 0);
-        this->index(N_i, -1) = this->index(N_i-1, 0);
-        this->index(-1, N_j) = this->index(0, N_j-1);
-        this->index(N_i, N_j) = this->index(N_i-1, N_j-1);
+        this->index(this->N_i, -1) = this->index(this->N_i-1, 0);
+        this->index(-1, this->N_j) = this->index(0, this->N_j-1);
+        this->index(this->N_i, this->N_j) = this->index(this->N_i-1, this->N_j-1);
         
         // top and bottom sides
-        for(int i = 0; i < N_i; i++){
-            this->index(i, -1) = this->index(i, 0);
-            this->index(i, N_j) = this->index(i, N_j-1);
-        }
-        for(int j = 0; j < N_j; j++){
+        for(int i = 0; i < this->N_i; i++) this->update_side_boundary(i);
+        for(int j = 0; j < this->N_j; j++){
             this->index(-1, j) = this->index(0, j);
-            this->index(N_i, j) = this->index(N_i-1, j);
+            this->index(this->N_i, j) = this->index(this->N_i-1, j);
         }
     }
     else{ // this->bc == NEGATIVE
         // corners (negative of a negative!)
         this->index(-1, -1) = this->index(0, 0);
-        this->index(N_i, -1) = this->index(N_i-1, 0);
-        this->index(-1, N_j) = this->index(0, N_j-1);
-        this->index(N_i, N_j) = this->index(N_i-1, N_j-1);
+        this->index(this->N_i, -1) = this->index(this->N_i-1, 0);
+        this->index(-1, this->N_j) = this->index(0, this->N_j-1);
+        this->index(this->N_i, this->N_j) = this->index(this->N_i-1, this->N_j-1);
         
         // top and bottom sides
-        for(int i = 0; i < N_i; i++){
-            this->index(i, -1) = -this->index(i, 0);
-            this->index(i, N_j) = -this->index(i, N_j-1);
-        }
-        for(int j = 0; j < N_j; j++){
+        for(int i = 0; i < this->N_i; i++) this->update_side_boundary(i);
+        for(int j = 0; j < this->N_j; j++){
             this->index(-1, j) = -this->index(0, j);
-            this->index(N_i, j) = -this->index(N_i-1, j);
+            this->index(this->N_i, j) = -this->index(this->N_i-1, j);
         }
     }
 }
 
-template<class T>
-Field<T>& Field<T>::operator=(const T *rhs){
+template<class T, int NI, int NJ>
+Field<T, NI, NJ>& Field<T, NI, NJ>::operator=(const T *rhs){
     for(int i = 0; i < this->N_i; i++)
         for(int j = 0; j < this->N_j; j++)
             this->index(i, j) = rhs[i*this->N_j+j];
@@ -102,8 +190,8 @@ Field<T>& Field<T>::operator=(const T *rhs){
     return *this;
 }
 
-template<class T>
-Field<T>& Field<T>::operator=(const Field &rhs){
+template<class T, int NI, int NJ>
+Field<T, NI, NJ>& Field<T, NI, NJ>::operator=(const Field &rhs){
     for(int i = 0; i < this->N_i; i++)
         for(int j = 0; j < this->N_j; j++)
             this->index(i, j) = rhs.index(i, j);
@@ -111,28 +199,42 @@ Field<T>& Field<T>::operator=(const Field &rhs){
     return *this;
 }
 
-template<class T>
-std::string Field<T>::toString(int precision, bool inside_only) const{
+template<class T, int NI, int NJ>
+Field<T, NI, NJ>& Field<T, NI, NJ>::operator=(Field &&rhs){
+    this->swap(rhs); // rhs gets our old memory, and frees it when it goes
+    return *this;
+}
+
+template<class T, int NI, int NJ>
+void Field<T, NI, NJ>::swap(Field &rhs){
+    FieldShape<NI, NJ>::swap(rhs);
+    std::swap(this->bc, rhs.bc);
+    std::swap(this->_arr, rhs._arr);
+    std::swap(this->_owns_arr, rhs._owns_arr);
+}
+
+template<class T, int NI, int NJ>
+std::string Field<T, NI, NJ>::toString(int precision, bool inside_only) const{
     std::stringstream ss;
     if(precision != -1){
         ss << std::fixed << std::setprecision(precision);
     }
     if(inside_only){
-        for(int i = 0; i < N_i; i++){
-            for(int j = 0; j < N_j; j++){
+        for(int i = 0; i < this->N_i; i++){
+            for(int j = 0; j < this->N_j; j++){
                 ss << this->index(i, j);
-                if(j != N_j-1) ss << " ";
+                if(j != this->N_j-1) ss << " ";
             }
-            if(i != N_i-1) ss << "\n";
+            if(i != this->N_i-1) ss << "\n";
         }
     }
     else{
-        for(int i = -1; i < N_i+1; i++){
-            for(int j = -1; j < N_j+1; j++){
+        for(int i = -1; i < this->N_i+1; i++){
+            for(int j = -1; j < this->N_j+1; j++){
                 ss << this->index(i, j);
-                if(j != N_j) ss << " ";
+                if(j != this->N_j) ss << " ";
             }
-            if(i != N_i) ss << "\n";
+            if(i != this->N_i) ss << "\n";
         }
     }
     return ss.str();
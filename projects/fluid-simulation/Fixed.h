@@ -0,0 +1,90 @@
+// Fixed
+// A fixed-point number with FRAC fractional bits, stored in STORAGE_T. WIDE_T must be able to hold
+//  the product of two STORAGE_T values, e.g. Fixed<16, int32_t, int64_t> is Q16.16 and
+//  Fixed<8, int16_t, int32_t> is Q8.8. It converts from int, float, and double implicitly so that
+//  the operations in operations.h can be written once for both float and fixed-point fields, but
+//  it only converts back to float explicitly.
+
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <cstdint>
+#include <type_traits>
+#include <iostream>
+
+template<int FRAC, class STORAGE_T, class WIDE_T>
+class Fixed{
+    public:
+        static const WIDE_T ONE = (WIDE_T)1 << FRAC;
+
+        STORAGE_T raw;
+
+        Fixed() = default;
+        Fixed(int value) : raw((STORAGE_T)(value*ONE)) {}
+        Fixed(float value) : raw((STORAGE_T)(value*ONE + (value < 0 ? -0.5f : 0.5f))) {} // rounds to nearest
+        Fixed(double value) : raw((STORAGE_T)(value*ONE + (value < 0 ? -0.5 : 0.5))) {}
+
+        // Conversion between formats has to be asked for, or else mixed expressions get ambiguous
+        template<int OTHER_FRAC, class OTHER_STORAGE_T, class OTHER_WIDE_T>
+        explicit Fixed(const Fixed<OTHER_FRAC, OTHER_STORAGE_T, OTHER_WIDE_T> &other){
+            if(OTHER_FRAC > FRAC) raw = (STORAGE_T)(other.raw >> (OTHER_FRAC > FRAC ? OTHER_FRAC-FRAC : 0));
+            else raw = (STORAGE_T)((WIDE_T)other.raw << (FRAC > OTHER_FRAC ? FRAC-OTHER_FRAC : 0));
+        }
+
+        static Fixed from_raw(STORAGE_T raw){
+            Fixed result;
+            result.raw = raw;
+            return result;
+        }
+
+        explicit operator float() const { return raw*(1.0f/ONE); }
+
+        // Rounds toward negative infinity, like FLOOR in operations.h
+        int floor() const { return raw >> FRAC; }
+
+        Fixed& operator+=(const Fixed &rhs){ raw += rhs.raw; return *this; }
+        Fixed& operator-=(const Fixed &rhs){ raw -= rhs.raw; return *this; }
+        Fixed& operator*=(const Fixed &rhs){ *this = *this*rhs; return *this; }
+        Fixed& operator/=(const Fixed &rhs){ *this = *this/rhs; return *this; }
+
+        Fixed operator-() const { return from_raw(-raw); }
+
+        friend Fixed operator+(const Fixed &lhs, const Fixed &rhs){ return from_raw(lhs.raw+rhs.raw); }
+        friend Fixed operator-(const Fixed &lhs, const Fixed &rhs){ return from_raw(lhs.raw-rhs.raw); }
+        friend Fixed operator*(const Fixed &lhs, const Fixed &rhs){ // rounds, or else repeated products drift down
+            return from_raw((STORAGE_T)(((WIDE_T)lhs.raw*rhs.raw + (ONE >> 1)) >> FRAC));
+        }
+        friend Fixed operator/(const Fixed &lhs, const Fixed &rhs){
+            return from_raw((STORAGE_T)(((WIDE_T)lhs.raw*ONE)/rhs.raw));
+        }
+
+        // Multiplying or dividing by an integer needs no shift. These are templates so that a float
+        //  operand isn't silently truncated to an int to match them.
+        template<class INT_T, class = typename std::enable_if<std::is_integral<INT_T>::value>::type>
+        friend Fixed operator*(const Fixed &lhs, INT_T rhs){ return from_raw(lhs.raw*rhs); }
+        template<class INT_T, class = typename std::enable_if<std::is_integral<INT_T>::value>::type>
+        friend Fixed operator*(INT_T lhs, const Fixed &rhs){ return from_raw(lhs*rhs.raw); }
+        template<class INT_T, class = typename std::enable_if<std::is_integral<INT_T>::value>::type>
+        friend Fixed operator/(const Fixed &lhs, INT_T rhs){ return from_raw(lhs.raw/rhs); }
+
+        friend bool operator<(const Fixed &lhs, const Fixed &rhs){ return lhs.raw < rhs.raw; }
+        friend bool operator>(const Fixed &lhs, const Fixed &rhs){ return lhs.raw > rhs.raw; }
+        friend bool operator<=(const Fixed &lhs, const Fixed &rhs){ return lhs.raw <= rhs.raw; }
+        friend bool operator>=(const Fixed &lhs, const Fixed &rhs){ return lhs.raw >= rhs.raw; }
+        friend bool operator==(const Fixed &lhs, const Fixed &rhs){ return lhs.raw == rhs.raw; }
+        friend bool operator!=(const Fixed &lhs, const Fixed &rhs){ return lhs.raw != rhs.raw; }
+};
+
+template<int FRAC, class STORAGE_T, class WIDE_T>
+const WIDE_T Fixed<FRAC, STORAGE_T, WIDE_T>::ONE;
+
+template<int FRAC, class STORAGE_T, class WIDE_T>
+std::ostream& operator<<(std::ostream &os, const Fixed<FRAC, STORAGE_T, WIDE_T> &rhs){
+    os << (float)rhs;
+    return os;
+}
+
+typedef Fixed<16, int32_t, int64_t> q16_16_t;
+typedef Fixed<8, int16_t, int32_t> q8_8_t;
+
+#endif
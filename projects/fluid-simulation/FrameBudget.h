@@ -0,0 +1,72 @@
+// FrameBudget
+// Picks the number of pressure solver iterations for the next frame so that the sim's own work per
+//  frame (not counting waiting on the draw) comes out to a target time, and picks the time step to
+//  match how much real time the frames actually take. Both come from running averages of the
+//  measured times, so one slow frame (like the first under a new touch) doesn't throw them off.
+// The solver can still stop short of iterations() once it has converged, and the next estimate of
+//  the time per iteration uses however many it did run.
+
+#ifndef FRAME_BUDGET_H
+#define FRAME_BUDGET_H
+
+class FrameBudget{
+    public:
+        FrameBudget(float target_time, int min_iterations, int max_iterations, float min_dt, float max_dt);
+
+        int iterations() const { return this->_iterations; }
+        float dt() const { return this->_dt; }
+
+        // frame_time is the real time since the last frame started, work_time is how much of it the
+        //  sim was working, and solver_time is how much of that the solver took to run iterations_run
+        void update(float frame_time, float work_time, float solver_time, int iterations_run);
+    private:
+        float _target_time;
+        int _min_iterations, _max_iterations;
+        float _min_dt, _max_dt;
+
+        float _iteration_time, _other_time, _frame_time; // running averages
+        int _iterations;
+        float _dt;
+};
+
+#define FRAME_BUDGET_SMOOTHING 0.2 // weight of the newest measurement in the running averages
+
+inline FrameBudget::FrameBudget(float target_time, int min_iterations, int max_iterations, float min_dt, float max_dt){
+    this->_target_time = target_time;
+    this->_min_iterations = min_iterations;
+    this->_max_iterations = max_iterations;
+    this->_min_dt = min_dt;
+    this->_max_dt = max_dt;
+
+    // nothing's been measured yet, so start at the most iterations and assume the target frame time
+    this->_iteration_time = 0;
+    this->_other_time = 0;
+    this->_frame_time = target_time;
+    this->_iterations = max_iterations;
+    this->_dt = (target_time < min_dt)? min_dt : ((target_time > max_dt)? max_dt : target_time);
+}
+
+inline void FrameBudget::update(float frame_time, float work_time, float solver_time, int iterations_run){
+    const float a = FRAME_BUDGET_SMOOTHING;
+    if(iterations_run > 0){
+        float iteration_time = solver_time/iterations_run;
+        this->_iteration_time = (this->_iteration_time == 0)?
+            iteration_time : (1-a)*this->_iteration_time+a*iteration_time;
+    }
+    this->_other_time = (1-a)*this->_other_time+a*(work_time-solver_time);
+    this->_frame_time = (1-a)*this->_frame_time+a*frame_time;
+
+    int iterations = this->_max_iterations;
+    if(this->_iteration_time > 0)
+        iterations = (this->_target_time-this->_other_time)/this->_iteration_time;
+    if(iterations < this->_min_iterations) iterations = this->_min_iterations;
+    if(iterations > this->_max_iterations) iterations = this->_max_iterations;
+    this->_iterations = iterations;
+
+    float dt = this->_frame_time;
+    if(dt < this->_min_dt) dt = this->_min_dt;
+    if(dt > this->_max_dt) dt = this->_max_dt;
+    this->_dt = dt;
+}
+
+#endif
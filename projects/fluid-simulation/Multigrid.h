@@ -0,0 +1,164 @@
+// Multigrid
+// Solves for the pressure like sor_pressure, but with V-cycles of geometric multigrid. SOR is quick
+//  to smooth out the error between neighboring cells but very slow to get rid of error spanning the
+//  whole domain, so each cycle smooths a little on the given grid, then solves for what's left on
+//  grids of half the size, where that error spans fewer cells, and adds the correction back.
+// The grid is halved for as long as both sizes are even (60x80 -> 30x40 -> 15x20) and then the
+//  coarsest one is solved with plain SOR. The coarse grids are allocated once, by the constructor.
+// The caller's grid can be a fixed-size Field, but the coarse grids always have their shape set at 
+//  runtime.
+
+#ifndef MULTIGRID_H
+#define MULTIGRID_H
+
+#include "Field.h"
+#include "operations.h"
+
+#define MULTIGRID_MAX_LEVELS 8
+
+template<class SCALAR_T>
+class Multigrid{
+    public:
+        int pre_smoothing = 2, post_smoothing = 2; // Gauss-Seidel iterations around each restriction
+        int coarsest_iterations = 20; // SOR iterations on the coarsest grid
+        float coarsest_omega = 1.7;
+
+        Multigrid(int N_i, int N_j, Arena *arena = NULL); // the coarse grids go in the arena, if given
+        ~Multigrid();
+
+        // How much of an arena the coarse grids for an N_i by N_j grid take
+        static size_t storage_bytes(int N_i, int N_j);
+
+        // Starts from zero pressure like sor_pressure, or from the pressure as it is scaled by 
+        //  carry_over (see carry_over_pressure). If residuals isn't NULL, the worst residual after each 
+        //  cycle is written to it, which takes an extra pass over the grid per cycle.
+        template<int NI, int NJ>
+        void solve(Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T, NI, NJ> *divergence, int cycles, float *residuals = NULL, 
+            float carry_over = 0);
+
+        int levels() const { return _levels; }
+    private:
+        // The correction and its right-hand side on each coarse grid. Level 0 is the caller's grid,
+        //  so index 0 is unused.
+        Field<SCALAR_T> *_corrections[MULTIGRID_MAX_LEVELS], *_rhs[MULTIGRID_MAX_LEVELS];
+        int _levels;
+
+        template<int NI, int NJ>
+        void v_cycle(int level, Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T, NI, NJ> *divergence);
+        template<int NI, int NJ>
+        void restrict_residual(Field<SCALAR_T> *coarse_rhs, const Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T, NI, NJ> *divergence);
+        template<int NI, int NJ>
+        void prolong_and_add(Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T> *coarse_correction);
+};
+
+template<class SCALAR_T>
+Multigrid<SCALAR_T>::Multigrid(int N_i, int N_j, Arena *arena){
+    this->_levels = 1;
+    this->_corrections[0] = NULL;
+    this->_rhs[0] = NULL;
+    while(N_i%2 == 0 && N_j%2 == 0 && this->_levels < MULTIGRID_MAX_LEVELS){
+        N_i /= 2;
+        N_j /= 2;
+        this->_corrections[this->_levels] = new Field<SCALAR_T>(N_i, N_j, CLONE, arena);
+        this->_rhs[this->_levels] = new Field<SCALAR_T>(N_i, N_j, DONTCARE, arena);
+        this->_levels++;
+    }
+}
+
+template<class SCALAR_T>
+size_t Multigrid<SCALAR_T>::storage_bytes(int N_i, int N_j){
+    size_t bytes = 0;
+    for(int levels = 1; N_i%2 == 0 && N_j%2 == 0 && levels < MULTIGRID_MAX_LEVELS; levels++){
+        N_i /= 2;
+        N_j /= 2;
+        bytes += 2*Arena::bytes<SCALAR_T>((N_i+2)*(N_j+2));
+    }
+    return bytes;
+}
+
+template<class SCALAR_T>
+Multigrid<SCALAR_T>::~Multigrid(){
+    for(int level = 1; level < this->_levels; level++){
+        delete this->_corrections[level];
+        delete this->_rhs[level];
+    }
+}
+
+template<class SCALAR_T>
+template<int NI, int NJ>
+void Multigrid<SCALAR_T>::solve(Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T, NI, NJ> *divergence, int cycles, float *residuals, 
+        float carry_over){
+    carry_over_pressure(pressure, carry_over);
+
+    for(int cycle = 0; cycle < cycles; cycle++){
+        this->v_cycle(0, pressure, divergence);
+        if(residuals != NULL) residuals[cycle] = pressure_residual(pressure, divergence);
+    }
+}
+
+template<class SCALAR_T>
+template<int NI, int NJ>
+void Multigrid<SCALAR_T>::v_cycle(int level, Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T, NI, NJ> *divergence){
+    if(level == this->_levels-1){
+        sor_iterate(pressure, divergence, this->coarsest_iterations, this->coarsest_omega);
+        return;
+    }
+
+    sor_iterate(pressure, divergence, this->pre_smoothing, 1);
+
+    Field<SCALAR_T> *coarse_correction = this->_corrections[level+1], *coarse_rhs = this->_rhs[level+1];
+    this->restrict_residual(coarse_rhs, pressure, divergence);
+    for(int i = 0; i < coarse_correction->N_i; i++)
+        for(int j = 0; j < coarse_correction->N_j; j++)
+            coarse_correction->index(i, j) = 0;
+    coarse_correction->update_boundary();
+    this->v_cycle(level+1, coarse_correction, coarse_rhs);
+    this->prolong_and_add(pressure, coarse_correction);
+
+    sor_iterate(pressure, divergence, this->post_smoothing, 1);
+}
+
+// Each coarse cell covers 2x2 fine cells. The equation on the coarse grid is in the same units as
+//  sor_pressure's (neighbors minus four times the center), which on a grid twice as coarse makes
+//  its right-hand side four times the average residual, i.e. just the sum of the four
+template<class SCALAR_T>
+template<int NI, int NJ>
+void Multigrid<SCALAR_T>::restrict_residual(Field<SCALAR_T> *coarse_rhs, const Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T, NI, NJ> *divergence){
+    parallel_for(0, coarse_rhs->N_i, [&](int I_begin, int I_end){
+        for(int I = I_begin; I < I_end; I++){
+            for(int J = 0; J < coarse_rhs->N_j; J++){
+                SCALAR_T sum = 0;
+                for(int i = 2*I; i < 2*I+2; i++){
+                    for(int j = 2*J; j < 2*J+2; j++){
+                        SCALAR_T laplacian = pressure->index(i-1, j)+pressure->index(i+1, j)
+                            +pressure->index(i, j-1)+pressure->index(i, j+1)-pressure->index(i, j)*4;
+                        sum += divergence->index(i, j)-laplacian;
+                    }
+                }
+                coarse_rhs->index(I, J) = sum;
+            }
+        }
+    });
+}
+
+// Bilinear interpolation between coarse cell centers, with the 9/16, 3/16, 3/16, 1/16 weights that
+//  works out to. The nearest coarse neighbors of a fine cell are on its side of the coarse cell.
+template<class SCALAR_T>
+template<int NI, int NJ>
+void Multigrid<SCALAR_T>::prolong_and_add(Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T> *coarse_correction){
+    parallel_for(0, pressure->N_i, [&](int i_begin, int i_end){
+        for(int i = i_begin; i < i_end; i++){
+            int I = i/2, I_near = (i%2 == 0)? I-1 : I+1;
+            for(int j = 0; j < pressure->N_j; j++){
+                int J = j/2, J_near = (j%2 == 0)? J-1 : J+1;
+                SCALAR_T correction = coarse_correction->index(I, J)*9
+                    +coarse_correction->index(I_near, J)*3+coarse_correction->index(I, J_near)*3
+                    +coarse_correction->index(I_near, J_near);
+                pressure->index(i, j) += correction/16;
+            }
+        }
+    });
+    pressure->update_boundary();
+}
+
+#endif
@@ -2,18 +2,16 @@
 #define VECTOR_H
 
 #include <iostream>
+#include <type_traits>
 
 template<typename T>
 class Vector{
     public:
         T x;
         T y;
-        
-        Vector& operator=(const Vector &rhs){
-            this->x = rhs.x;
-            this->y = rhs.y;
-            return *this;
-        }
+
+        // Copying is left implicit, so that Vector stays an aggregate and its copy constructor and 
+        //  assignment agree.
         Vector& operator+=(const Vector &rhs){
             this->x += rhs.x;
             this->y += rhs.y;
@@ -24,12 +22,12 @@ class Vector{
             this->y -= rhs.y;
             return *this;
         }
-        Vector& operator*=(const float &rhs){
+        Vector& operator*=(const T &rhs){
             this->x *= rhs;
             this->y *= rhs;
             return *this;
         }
-        Vector& operator/=(const float &rhs){
+        Vector& operator/=(const T &rhs){
             this->x /= rhs;
             this->y /= rhs;
             return *this;
@@ -38,13 +36,16 @@ class Vector{
         Vector operator-() const{ return {-this->x, -this->y}; }
         Vector operator+(const Vector &rhs) const{ return {this->x+rhs.x, this->y+rhs.y}; }
         Vector operator-(const Vector &rhs) const{ return {this->x-rhs.x, this->y-rhs.y}; }
-        Vector operator*(const float &rhs) const{ return {this->x*rhs, this->y*rhs}; }
-        Vector operator/(const float &rhs) const{ return {this->x/rhs, this->y/rhs}; }
+        Vector operator*(const T &rhs) const{ return {this->x*rhs, this->y*rhs}; }
+        Vector operator/(const T &rhs) const{ return {this->x/rhs, this->y/rhs}; }
 };
 
-// Scalar multiplication is commutative, so this fulfills that requirement
-template<typename T>
-inline Vector<T> operator*(const float &lhs, const Vector<T> &rhs){ return rhs*lhs; }
+// Scalar multiplication is commutative, so this fulfills that requirement. The scalar is converted
+//  to the component type first, so a float time step also scales a fixed-point vector. Only 
+//  arithmetic types and the component type itself are taken as the scalar.
+template<typename T, typename S, 
+        class = typename std::enable_if<std::is_arithmetic<S>::value || std::is_same<S, T>::value>::type>
+inline Vector<T> operator*(const S &lhs, const Vector<T> &rhs){ return rhs*T(lhs); }
 
 template<typename T>
 std::ostream& operator<<(std::ostream &os, const Vector<T> &rhs){
@@ -0,0 +1,56 @@
+// VectorField
+// A field of 2D vectors stored as two planes, one Field for the x components and one for the y
+//  components, instead of one Field of Vectors with the two interleaved. Both planes have the same
+//  shape and boundary, so index(i, j) is the same offset into each. The operations in operations.h
+//  that take a VectorField read each plane with unit stride and never build Vector temporaries.
+// Like Field, VectorField<T> has its shape set at runtime and VectorField<T, NI, NJ> has it fixed.
+
+#ifndef VECTOR_FIELD_H
+#define VECTOR_FIELD_H
+
+#include <string>
+
+#include "Vector.h"
+#include "Field.h"
+
+template<class T, int NI = 0, int NJ = 0>
+class VectorField : public FieldShape<NI, NJ>{
+    public:
+        Field<T, NI, NJ> x, y;
+
+        VectorField(int N_i, int N_j, BoundaryCondition bc, Arena *arena = NULL) 
+            : FieldShape<NI, NJ>(N_i, N_j), x(N_i, N_j, bc, arena), y(N_i, N_j, bc, arena) {}
+        // Only for fixed-size VectorFields, see the Field constructors
+        explicit VectorField(BoundaryCondition bc, Arena *arena = NULL) 
+            : FieldShape<NI, NJ>(NI, NJ), x(bc, arena), y(bc, arena) {}
+        VectorField(T *x_storage, T *y_storage, BoundaryCondition bc) 
+            : FieldShape<NI, NJ>(NI, NJ), x(x_storage, bc), y(y_storage, bc) {}
+
+        // Boundary exists at i = -1, i = N_i, j = -1, j = N_j
+        Vector<T> index(int i, int j) const { return {this->x.index(i, j), this->y.index(i, j)}; }
+        void set(int i, int j, const Vector<T> &value){
+            this->x.index(i, j) = value.x;
+            this->y.index(i, j) = value.y;
+        }
+        void update_boundary(){ // Make sure to call this after updating values!
+            this->x.update_boundary();
+            this->y.update_boundary();
+        }
+
+        VectorField& operator=(const VectorField &rhs){
+            this->x = rhs.x;
+            this->y = rhs.y;
+            return *this;
+        }
+        void swap(VectorField &rhs){ // exchanges the memory of both planes instead of copying values
+            FieldShape<NI, NJ>::swap(rhs);
+            this->x.swap(rhs.x);
+            this->y.swap(rhs.y);
+        }
+
+        std::string toString(int precision = -1, bool inside_only = true) const{
+            return "x:\n"+this->x.toString(precision, inside_only)+"\ny:\n"+this->y.toString(precision, inside_only);
+        }
+};
+
+#endif
@@ -5,9 +5,17 @@
 #include <XPT2046_Touchscreen.h>
 
 #include "iram_float.h"
+#include "Fixed.h"
+#include "unorm8.h"
 #include "Vector.h"
 #include "Field.h"
+#include "VectorField.h"
+#include "DoubleBuffer.h"
+#include "Backtrace.h"
 #include "operations.h"
+#include "Multigrid.h"
+#include "FrameBudget.h"
+#include "Arena.h"
 
 // configurables
 #define N_ROWS 60 // size of sim domain
@@ -15,9 +23,41 @@
 #define SCALING 4 // integer scaling of domain -> screen size is inferred from this
 #define TILE_HEIGHT 60 // multiple of SCALING and a factor of (N_ROWS*SCALING)
 #define TILE_WIDTH 80  // multiple of SCALING and a factor of (N_COLS*SCALING)
-#define DT 1/12.0 // s, size of time step in sim time (should roughly match real FPS)
+#define TARGET_FRAME_TIME 1/12.0 // s, of sim work per frame, which the number of SOR iterations is adjusted to meet
+#define MIN_SOR_ITERATIONS 2
+#define MAX_SOR_ITERATIONS 20
+#define PRESSURE_TOLERANCE 0.5 // SOR stops early once the worst residual of the pressure equation is under this
+#define SOR_CHECK_PERIOD 5 // iterations between checks of the residual, which each take about as long as one
+#define PRESSURE_CARRY_OVER 0.9 // 0 to 1, how much of the last frame's pressure each solve starts from (see test_fluid_multigrid)
+#define MIN_DT 1/30.0 // s, the time step follows the real time the frames take, but within these bounds
+#define MAX_DT 1/6.0
 #define POLLING_PERIOD 20 // ms, for the touch screen
-// #define DIVERGENCE_TRACKING // if commented out, disables divergence tracking for some extra FPS
+#define FORCED_REFRESH_PERIOD 60 // frames, every tile is pushed at least this often even if it looks unchanged
+// #define FIXED_POINT // if uncommented, simulates in Q16.16 and stores the colors in Q8.8 instead of float
+// #define DYE_8BIT // if uncommented, stores the colors in one byte each (see unorm8.h), with either number type
+// #define MULTIGRID // if uncommented, solves for the pressure with multigrid instead of SOR, and reports the residuals
+#define MULTIGRID_CYCLES 1 // each one takes about as long as the 10 SOR iterations and leaves a ~4x smaller residual
+
+
+// number types of the sim
+#ifdef FIXED_POINT
+typedef q16_16_t sim_scalar_t; // velocity, pressure, and divergence
+#else
+typedef float sim_scalar_t;
+#endif
+#if defined(DYE_8BIT)
+typedef unorm8_t dye_t; // colors, 0 to 1 (one byte each)
+#elif defined(FIXED_POINT)
+typedef q8_8_t dye_t; // colors, 0 to 1 (two bytes each, so they fit in DRAM with no IRAM workaround)
+#else
+typedef iram_float_t dye_t;
+#define DYE_IN_IRAM
+#endif
+
+// The fields all have the shape of the domain, which makes every offset into them a compile-time constant
+typedef VectorField<sim_scalar_t, N_ROWS, N_COLS> velocity_field_t;
+typedef Field<sim_scalar_t, N_ROWS, N_COLS> sim_field_t;
+typedef Field<dye_t, N_ROWS, N_COLS> dye_field_t;
 
 
 // touch resources
@@ -36,13 +76,127 @@ const int XPT2046_CS = 33;
 SPIClass ts_spi = SPIClass(VSPI);
 XPT2046_Touchscreen ts(XPT2046_CS, XPT2046_IRQ);
 
-// essential sim resources
+// essential sim resources, all allocated once in setup() so that the sim loop never allocates
 // TODO: allocation here causes a crash, AND runtime allocation of the 
-//  velocity field AFTER the color fields causes a crash?
-Field<Vector<float>> *velocity_field;
-Field<iram_float_t> *red_field, *green_field, *blue_field;
+//  velocity field AFTER the color fields causes a crash? setup() now reserves the memory regions 
+//  first (see below) and places everything in them, so the order is at least always the same.
+DoubleBuffer<velocity_field_t> *velocity_buffer; // advection reads the front and writes the back
+velocity_field_t *velocity_field; // the front of velocity_buffer, which stays put across swaps
+sim_field_t *divergence_field, *pressure_field;
+dye_field_t *red_field, *green_field, *blue_field;
+dye_field_t *color_scratch_field; // each color is advected into this, then swapped with it
+Backtrace *color_backtrace; // the colors all move with the same velocity, so where they come from is found once
+#ifdef MULTIGRID
+Multigrid<sim_scalar_t> *multigrid; // holds the coarse grids
+#endif
+
+// memory regions, reserved at the start of setup() (see Arena.h). The fields the sim reads every 
+//  step go in fast internal DRAM, and the colors go in PSRAM if the board has any, or else in IRAM 
+//  if they're floats (see iram_float.h) or DRAM if they're smaller. No region of the classic ESP32 
+//  has a free block big enough for all of its fields, so each gets a chain of arenas, one per group 
+//  of fields in the order setup() places them. If any of them can't be reserved, setup() stops there.
+Arena *sim_arena, *dye_arena; // the first of each chain
+
+#define DRAM_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+// Only IRAM and the D/IRAM that's shared with DRAM can be executed from, and IRAM is picked first
+#define IRAM_CAPS (MALLOC_CAP_EXEC | MALLOC_CAP_32BIT)
+
+void halt(){
+  Serial.println("Stopped.");
+  while(1) delay(1000);
+}
+
+// Reserves an arena from the region with the given caps, and adds it to the end of the chain that 
+//  starts at *first (or starts it). Halts if the region has no free block that big.
+void reserve_arena(Arena **first, const char *name, size_t size, uint32_t caps){
+  size_t largest = heap_caps_get_largest_free_block(caps);
+  Arena *arena = (largest >= size)? new Arena(name, size, caps) : NULL;
+  if(arena == NULL || !arena->reserved()){
+    Serial.print("Couldn't reserve ");
+    Serial.print(size);
+    Serial.print(" bytes of ");
+    Serial.print(name);
+    Serial.print(", the largest free block is ");
+    Serial.print(largest);
+    Serial.println(" bytes");
+    halt();
+  }
+
+  if(*first == NULL) *first = arena;
+  else (*first)->chain(arena);
+}
+
+void reserve_arenas(){
+  size_t plane_bytes = Arena::bytes<sim_scalar_t>(sim_field_t::STORAGE_ELEMS);
+  size_t dye_bytes = Arena::bytes<dye_t>(dye_field_t::STORAGE_ELEMS);
+  sim_arena = dye_arena = NULL;
+
+  reserve_arena(&sim_arena, "DRAM", 2*plane_bytes, DRAM_CAPS); // front velocity
+  reserve_arena(&sim_arena, "DRAM", 2*plane_bytes, DRAM_CAPS); // back velocity
+  reserve_arena(&sim_arena, "DRAM", 2*plane_bytes, DRAM_CAPS); // divergence and pressure
+  size_t rest_bytes = Backtrace::storage_bytes(N_ROWS, N_COLS);
+  #ifdef MULTIGRID
+  rest_bytes += Multigrid<sim_scalar_t>::storage_bytes(N_ROWS, N_COLS);
+  #endif
+  reserve_arena(&sim_arena, "DRAM", rest_bytes, DRAM_CAPS);
+
+  // the colors and their scratch
+  if(heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) >= 4*dye_bytes){
+    reserve_arena(&dye_arena, "PSRAM", 4*dye_bytes, MALLOC_CAP_SPIRAM);
+    return;
+  }
+  for(int k = 0; k < 4; k++){
+    #ifdef DYE_IN_IRAM
+    reserve_arena(&dye_arena, "IRAM", dye_bytes, IRAM_CAPS);
+    #else
+    reserve_arena(&dye_arena, "DRAM", dye_bytes, DRAM_CAPS);
+    #endif
+  }
+}
+
+// Halts if any field didn't fit where it was planned to go, which would make where it ended up 
+//  depend on the allocation order again
+void check_arenas(){
+  for(const Arena *arena : {sim_arena, dye_arena}){
+    for(; arena != NULL; arena = arena->next()){
+      if(arena->misses() > 0){
+        Serial.print(arena->misses());
+        Serial.print(" fields didn't fit in the ");
+        Serial.print(arena->name);
+        Serial.println(" arenas");
+        halt();
+      }
+    }
+  }
+}
+
+void report_arena(const Arena *arena){
+  Serial.print(arena->name);
+  Serial.print(" arena at 0x");
+  Serial.print((uintptr_t)arena->base(), HEX);
+  Serial.print(": ");
+  Serial.print(arena->used());
+  Serial.print(" of ");
+  Serial.print(arena->size());
+  Serial.println(" bytes used");
+}
+
+void report_memory(){
+  for(const Arena *arena = sim_arena; arena != NULL; arena = arena->next()) report_arena(arena);
+  for(const Arena *arena = dye_arena; arena != NULL; arena = arena->next()) report_arena(arena);
+  Serial.print("Heap left: ");
+  Serial.print(heap_caps_get_free_size(DRAM_CAPS));
+  Serial.print(" bytes DRAM (largest block ");
+  Serial.print(heap_caps_get_largest_free_block(DRAM_CAPS));
+  Serial.print("), ");
+  Serial.print(heap_caps_get_free_size(IRAM_CAPS));
+  Serial.print(" bytes IRAM, ");
+  Serial.print(heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+  Serial.println(" bytes PSRAM");
+}
 
 // draw resources
+volatile unsigned long tiles_pushed = 0; // a running count, for the stats
 SemaphoreHandle_t color_consumed = xSemaphoreCreateBinary(), // read preceded by a write, and vice versa
     color_produced = xSemaphoreCreateBinary();
 TFT_eSPI tft = TFT_eSPI();
@@ -57,9 +211,13 @@ const int N_TILES = SCREEN_HEIGHT/TILE_HEIGHT, M_TILES = SCREEN_WIDTH/TILE_WIDTH
 SemaphoreHandle_t stats_consumed = xSemaphoreCreateBinary(), 
     stats_produced = xSemaphoreCreateBinary();
 struct stats{
-  unsigned long point_timestamps[6];
+  unsigned long point_timestamps[6]; // in us
+  int sor_iterations; // run in the latest frame
+  float sor_residual; // worst over domain after the SOR, at current time
+  float dt; // s, of the latest frame
   float current_abs_pct_density; // "current" -> worst over domain at current time
   float max_abs_pct_density; // "max" -> worst over domain and all time
+  float pressure_residuals[MULTIGRID_CYCLES]; // worst over domain after each cycle, at current time
   int refresh_count;
 };
 struct stats global_stats;
@@ -113,19 +271,22 @@ void sim_routine(void* args){
   // local stats and timing the reporting of those stats
   unsigned long now, last_reported = millis();
   struct stats local_stats = (struct stats){ .max_abs_pct_density = 0, .refresh_count = 0 };
+
+  // picks the SOR iterations and the time step of each frame from how long the last ones took
+  FrameBudget budget(TARGET_FRAME_TIME, MIN_SOR_ITERATIONS, MAX_SOR_ITERATIONS, MIN_DT, MAX_DT);
+  unsigned long last_frame_end = micros(), solver_time = 0;
+  int sor_iterations = 0;
   
   while(1){
-    local_stats.point_timestamps[0] = millis(); // holds the millis() for when calculating the time step started
+    local_stats.point_timestamps[0] = micros(); // holds the micros() for when calculating the time step started
+    const float dt = budget.dt();
     
 
     // Swap the velocity field with the advected one
-    Field<Vector<float>> *to_delete_vector = velocity_field,
-        *temp_vector_field = new Field<Vector<float>>(N_ROWS, N_COLS, NEGATIVE);
-    semilagrangian_advect(temp_vector_field, velocity_field, velocity_field, DT);
-    velocity_field = temp_vector_field;
-    delete to_delete_vector;
+    semilagrangian_advect(velocity_buffer->back(), velocity_field, velocity_field, dt);
+    velocity_buffer->swap();
 
-    local_stats.point_timestamps[1] = millis();
+    local_stats.point_timestamps[1] = micros();
 
 
     // Apply the captured drag (encoded as a sequence of touch structs) to the 
@@ -146,60 +307,72 @@ void sim_routine(void* args){
     //  "x", y, and "y" though, we swap them.
     struct touch current_touch;
     while(xQueueReceive(touch_queue, &current_touch, 0) == pdTRUE){ // empty the queue
-      velocity_field->index(current_touch.coords.y, current_touch.coords.x) = {
-          .x = current_touch.velocity.y, .y = current_touch.velocity.x};
+      velocity_field->set(current_touch.coords.y, current_touch.coords.x, {
+          .x = current_touch.velocity.y, .y = current_touch.velocity.x});
     }
     velocity_field->update_boundary(); // in case the dragging went near the boundary, we need to update it
 
 
-    // Get a divergence-free projection of the velocity field
+    // Get a divergence-free projection of the velocity field. Finding the divergence also starts the 
+    //  pressure from (most of) the last frame's, in the same pass.
+    float abs_divergence = divergence_and_carry_over(divergence_field, velocity_field, pressure_field, PRESSURE_CARRY_OVER);
+    #ifdef MULTIGRID
+    // Multigrid: gets rid of the error spanning the whole domain that SOR barely touches, see Multigrid.h
+    multigrid->solve(pressure_field, divergence_field, MULTIGRID_CYCLES, local_stats.pressure_residuals, 1);
+    abs_divergence = gradient_and_subtract_max_divergence(velocity_field, pressure_field);
+    #else
     // SOR: I found the spectral radius (60x80 grid, dx=dy=1, pure Neumann, 
     //  ignoring +1 and -1(!?) eigvals) to be 0.9996, therefore omega is 1.96
     // https://en.wikipedia.org/wiki/Successive_over-relaxation#Convergence_Rate
-    const float sor_omega = 1.96;
-    Field<float> *divergence_field = new Field<float>(N_ROWS, N_COLS, DONTCARE),
-        *pressure_field = new Field<float>(N_ROWS, N_COLS, CLONE);
-    divergence(divergence_field, velocity_field);
-    sor_pressure(pressure_field, divergence_field, 10, sor_omega);
-    gradient_and_subtract(velocity_field, pressure_field);
-    delete divergence_field;
-    delete pressure_field;
+    // That omega is only the best in the long run, though. With red-black ordering and just 10 
+    //  iterations, it leaves about 4x the worst residual that 1.3 does (see test_fluid_multigrid)
+    // The number of iterations is whatever fits in the frame budget, unless the pressure converges 
+    //  first. The pressure field is kept between frames, and starting from (most of) the last frame's 
+    //  pressure leaves the iterations much less to do. A still fluid skips the solve altogether, and 
+    //  with it the subtraction, since there's nothing to project out.
+    const float sor_omega = 1.3;
+    sor_iterations = 0;
+    solver_time = 0;
+    if(abs_divergence < PRESSURE_TOLERANCE){
+      // The pressure isn't zero but the carried over part of the last frame's, so its residual takes 
+      //  a pass of its own. Only a still fluid gets here, where there's time to spare.
+      local_stats.sor_residual = pressure_residual(pressure_field, divergence_field);
+    }else{
+      unsigned long solver_start = micros();
+      sor_iterations = sor_iterate_until(pressure_field, divergence_field, budget.iterations(), sor_omega, 
+          PRESSURE_TOLERANCE, SOR_CHECK_PERIOD, &local_stats.sor_residual);
+      solver_time = micros()-solver_start;
+      abs_divergence = gradient_and_subtract_max_divergence(velocity_field, pressure_field);
+    }
+    #endif
 
-    local_stats.point_timestamps[2] = millis();
+    // Find where the colors come from now, since it doesn't need to wait for them to be drawn
+    color_backtrace->trace(velocity_field, dt);
+
+    local_stats.point_timestamps[2] = micros();
 
 
     // Wait for the color field to be read/consumed already, and time this wait
     xSemaphoreTake(color_consumed, portMAX_DELAY);
-    local_stats.point_timestamps[3] = millis();
-
+    local_stats.point_timestamps[3] = micros();
 
-    // Replace the color field with the advected one, but do so by rotating the memory used
-    Field<iram_float_t> *temp, *temp_color_field = new Field<iram_float_t>(N_ROWS, N_COLS, CLONE);
-    
-    semilagrangian_advect(temp_color_field, red_field, velocity_field, DT);
-    temp = red_field;
-    red_field = temp_color_field;
-    temp_color_field = temp;
 
-    semilagrangian_advect(temp_color_field, green_field, velocity_field, DT);
-    temp = green_field;
-    green_field = temp_color_field;
-    temp_color_field = temp;
+    // Replace the color field with the advected one, but do so by swapping the memory used
+    color_backtrace->apply(color_scratch_field, red_field);
+    red_field->swap(*color_scratch_field);
 
-    semilagrangian_advect(temp_color_field, blue_field, velocity_field, DT);
-    temp = blue_field;
-    blue_field = temp_color_field;
-    temp_color_field = temp;
+    color_backtrace->apply(color_scratch_field, green_field);
+    green_field->swap(*color_scratch_field);
 
-    delete temp_color_field; // drop the memory that got rotated out
+    color_backtrace->apply(color_scratch_field, blue_field);
+    blue_field->swap(*color_scratch_field);
 
     // Signal that the color field has been written/produced as is ready to be read/consumed
     xSemaphoreGive(color_produced);
     
-    local_stats.point_timestamps[4] = millis();
+    local_stats.point_timestamps[4] = micros();
 
 
-    #ifdef DIVERGENCE_TRACKING
     // Assuming density is constant over the domain in the current time (which 
     //  is only a correct assumption if the divergence is equal to zero for all 
     //  time because the density is obviously constant over the domain at t=0), 
@@ -209,20 +382,23 @@ void sim_routine(void* args){
     // Furthermore, I'd argue that "expected density error in pct" is equal to 
     //  the divergence times the time step. This is a thing we can track.
     // TODO: research this and find a source?
-    float current_abs_divergence = 0; // "current" -> worst over domain at current time
-    Field<float> *new_divergence_field = new Field<float>(N_ROWS, N_COLS, DONTCARE); // "new" divergence after projection
-    divergence(new_divergence_field, velocity_field);
-    for(int i = 0; i < N_ROWS; i++)
-      for(int j = 0; j < N_COLS; j++)
-        if(abs(new_divergence_field->index(i, j)) > current_abs_divergence)
-          current_abs_divergence = abs(new_divergence_field->index(i, j));
-    local_stats.current_abs_pct_density = 100*current_abs_divergence*DT;
+    // The worst divergence left after the projection came out of the gradient subtraction, so this 
+    //  costs next to nothing and is always on.
+    local_stats.current_abs_pct_density = 100*abs_divergence*dt; // "current" -> worst over domain at current time
     if(local_stats.current_abs_pct_density > local_stats.max_abs_pct_density)
       local_stats.max_abs_pct_density = local_stats.current_abs_pct_density;
-    delete new_divergence_field;
-    #endif
 
-    local_stats.point_timestamps[5] = millis();
+    local_stats.point_timestamps[5] = micros();
+
+
+    // Fit the next frame into the budget. The time spent waiting on the draw doesn't count as work, 
+    //  but it does count towards the real time the time step should follow.
+    unsigned long *t = local_stats.point_timestamps;
+    unsigned long frame_time = t[5]-last_frame_end, work_time = (t[5]-t[0])-(t[3]-t[2]);
+    last_frame_end = t[5];
+    budget.update(frame_time/1e6, work_time/1e6, solver_time/1e6, sor_iterations);
+    local_stats.sor_iterations = sor_iterations;
+    local_stats.dt = dt;
 
 
     // Update the global stats
@@ -243,6 +419,74 @@ void sim_routine(void* args){
 }
 
 
+// Lookup tables from a dye level (0 to 256 for 0 to 1) to its part of an RGB565 color, with the 
+//  bytes already swapped like TFT_eSprite keeps them. The parts don't overlap, so OR-ing the three 
+//  gives the whole color.
+#define DYE_LEVELS 257
+uint16_t red_lut[DYE_LEVELS], green_lut[DYE_LEVELS], blue_lut[DYE_LEVELS];
+
+void init_color_luts(){
+  for(int level = 0; level < DYE_LEVELS; level++){
+    uint8_t value = level*255/256;
+    uint16_t red = tft.color565(value, 0, 0), green = tft.color565(0, value, 0), blue = tft.color565(0, 0, value);
+    red_lut[level] = (red >> 8) | (red << 8);
+    green_lut[level] = (green >> 8) | (green << 8);
+    blue_lut[level] = (blue >> 8) | (blue << 8);
+  }
+}
+
+inline int dye_to_level(float value){
+  int level = value*256;
+  return level < 0? 0 : (level > 256? 256 : level);
+}
+
+inline int dye_to_level(q8_8_t value){
+  return value.raw < 0? 0 : (value.raw > 256? 256 : value.raw);
+}
+
+inline int dye_to_level(unorm8_t value){
+  return value.raw+(value.raw >> 7); // 0 to 255 onto 0 to 256, always in range
+}
+
+// Fills the tile at (x_start, y_start) on the screen straight from the color fields. Each cell 
+//  becomes SCALING copies of its color across one row of pixels, written as pairs with 32-bit stores 
+//  when SCALING is even, and then that row is copied to the next SCALING-1 rows.
+// Returns a hash (FNV-1a) of the cell colors, so that draw_routine can tell if the tile changed
+uint32_t pack_tile(uint16_t *tile, int x_start, int y_start){
+  uint32_t hash = 2166136261u;
+
+  int x_cell_start = x_start/SCALING, x_cell_end = (x_start+TILE_WIDTH)/SCALING;
+  int y_cell_start = y_start/SCALING, y_cell_end = (y_start+TILE_HEIGHT)/SCALING;
+
+  for(int y_cell = y_cell_start; y_cell < y_cell_end; y_cell++){
+    // see above about the coordinate transform
+    int offset = red_field->offset(y_cell, 0); // the same for all three
+    const dye_t *red = red_field->data()+offset, *green = green_field->data()+offset, 
+        *blue = blue_field->data()+offset;
+
+    uint16_t *row = tile+(y_cell*SCALING-y_start)*TILE_WIDTH;
+    for(int x_cell = x_cell_start; x_cell < x_cell_end; x_cell++){
+      uint16_t color = red_lut[dye_to_level(red[x_cell])] | green_lut[dye_to_level(green[x_cell])] 
+          | blue_lut[dye_to_level(blue[x_cell])];
+      hash = (hash^color)*16777619u;
+
+      uint16_t *pixel = row+(x_cell*SCALING-x_start);
+      #if SCALING%2 == 0
+      uint32_t pair = color | ((uint32_t)color << 16);
+      for(int k = 0; k < SCALING/2; k++) ((uint32_t*)pixel)[k] = pair;
+      #else
+      for(int k = 0; k < SCALING; k++) pixel[k] = color;
+      #endif
+    }
+
+    for(int k = 1; k < SCALING; k++)
+      memcpy(row+k*TILE_WIDTH, row, TILE_WIDTH*sizeof(uint16_t));
+  }
+
+  return hash;
+}
+
+
 void draw_routine(void* args){
   // As mentioned earlier, the simulation operates on a rotated view of the 
   //  screen, so draw_routine needs to account for that
@@ -250,34 +494,35 @@ void draw_routine(void* args){
   tft.init();
   tft.fillScreen(TFT_BLACK);
   tft.initDMA();
+  init_color_luts();
 
   // pointers to tiles to be used for double-buffering
   TFT_eSprite *write_tile = &tiles[0], *read_tile = &tiles[1];
 
+  // the hash of what was last pushed to each tile, which is skipped if it comes out the same. A 
+  //  collision would leave a tile stale, so they're all pushed every FORCED_REFRESH_PERIOD frames.
+  uint32_t tile_hashes[N_TILES][M_TILES];
+  int frames_since_refresh = FORCED_REFRESH_PERIOD;
+
   while(1){
     xSemaphoreTake(color_produced, portMAX_DELAY);
     int buffer_select = 0;
 
+    bool force_refresh = frames_since_refresh >= FORCED_REFRESH_PERIOD;
+    frames_since_refresh = force_refresh? 0 : frames_since_refresh+1;
+
     tft.startWrite(); // start a single transfer for all the tiles
 
     for(int xx = 0; xx < M_TILES; xx++){
-      int x_start = xx*TILE_WIDTH, x_end = (xx+1)*TILE_WIDTH;
+      int x_start = xx*TILE_WIDTH;
       for(int yy = 0; yy < N_TILES; yy++){
-        int y_start = yy*TILE_HEIGHT, y_end = (yy+1)*TILE_HEIGHT;
-
-        int x_cell_start = x_start/SCALING, x_cell_end = x_end/SCALING;
-        for(int x_cell = x_cell_start; x_cell < x_cell_end; x_cell++){
-          int y_cell_start = y_start/SCALING, y_cell_end = y_end/SCALING;
-          for(int y_cell = y_cell_start; y_cell < y_cell_end; y_cell++){
-            // see above about the coordinate transform
-            int r = red_field->index(y_cell, x_cell)*255,
-                g = green_field->index(y_cell, x_cell)*255,
-                b = blue_field->index(y_cell, x_cell)*255;
-            
-            int y_local = y_cell*SCALING-y_start, x_local = x_cell*SCALING-x_start;
-            write_tile->fillRect(x_local, y_local, SCALING, SCALING, tft.color565(r, g, b));
-          }
-        }
+        int y_start = yy*TILE_HEIGHT;
+
+        uint32_t hash = pack_tile((uint16_t*)write_tile->getPointer(), x_start, y_start);
+        if(!force_refresh && hash == tile_hashes[yy][xx])
+          continue; // write_tile wasn't pushed, so it can be packed again right away
+        tile_hashes[yy][xx] = hash;
+        tiles_pushed++;
 
         // pushImageDMA also spin-waits until the previous transfer is done
         tft.pushImageDMA(x_start, y_start, TILE_WIDTH, TILE_HEIGHT, (uint16_t*)write_tile->getPointer());
@@ -298,6 +543,7 @@ void draw_routine(void* args){
 void stats_routine(void* args){
   struct stats local_stats;
   unsigned long now, last_reported = millis(), elapsed;
+  unsigned long last_tiles_pushed = 0;
   while(1){
     xSemaphoreTake(stats_produced, portMAX_DELAY);
     local_stats = global_stats;
@@ -309,10 +555,13 @@ void stats_routine(void* args){
     last_reported = now;
 
     float refresh_rate = 1000*(float)local_stats.refresh_count/elapsed;
+    unsigned long now_tiles_pushed = tiles_pushed;
+    float tiles_per_refresh = (float)(now_tiles_pushed-last_tiles_pushed)/local_stats.refresh_count;
+    last_tiles_pushed = now_tiles_pushed;
     float time_taken[5], total_time, pct_taken[5];
     for(int i = 0; i < 5; i++)
-      time_taken[i] = (local_stats.point_timestamps[i+1]-local_stats.point_timestamps[i])/1000.0;
-    total_time = (local_stats.point_timestamps[5]-local_stats.point_timestamps[0])/1000.0;
+      time_taken[i] = (local_stats.point_timestamps[i+1]-local_stats.point_timestamps[i])/1e6;
+    total_time = (local_stats.point_timestamps[5]-local_stats.point_timestamps[0])/1e6;
     for(int i = 0; i < 5; i++)
       pct_taken[i] = 100*time_taken[i]/total_time;
 
@@ -328,7 +577,6 @@ void stats_routine(void* args){
     Serial.print(")");
     Serial.print(", ");
 
-    #ifdef DIVERGENCE_TRACKING
     Serial.print("Err now: +/- ");
     Serial.print(local_stats.current_abs_pct_density, 1);
     Serial.print("%");
@@ -337,8 +585,35 @@ void stats_routine(void* args){
     Serial.print(local_stats.max_abs_pct_density, 1);
     Serial.print("%");
     Serial.print(", ");
+
+    #ifndef MULTIGRID
+    Serial.print("SOR iters: ");
+    Serial.print(local_stats.sor_iterations);
+    Serial.print(", ");
+    Serial.print("SOR residual: ");
+    Serial.print(local_stats.sor_residual, 3);
+    Serial.print(", ");
+    #endif
+    Serial.print("DT: ");
+    Serial.print(local_stats.dt*1000, 1);
+    Serial.print(" ms, ");
+
+    #ifdef MULTIGRID
+    Serial.print("Residuals: (");
+    for(int i = 0; i < MULTIGRID_CYCLES; i++){
+      Serial.print(local_stats.pressure_residuals[i], 3);
+      if(i < MULTIGRID_CYCLES-1) Serial.print(", ");
+    }
+    Serial.print(")");
+    Serial.print(", ");
     #endif
 
+    Serial.print("Tiles pushed: ");
+    Serial.print(tiles_per_refresh, 1);
+    Serial.print("/");
+    Serial.print(N_TILES*M_TILES);
+    Serial.print(", ");
+
     Serial.print("Touch queue sz: ");
     Serial.print(uxQueueMessagesWaiting(touch_queue));
     Serial.println();
@@ -351,21 +626,35 @@ void setup(void) {
   pinMode(0, INPUT_PULLUP);
 
 
+  Serial.println("Reserving memory...");
+  reserve_arenas();
+
+
   Serial.println("Initializing velocity field...");
-  velocity_field = new Field<Vector<float>>(N_ROWS, N_COLS, NEGATIVE);
+  velocity_buffer = new DoubleBuffer<velocity_field_t>(NEGATIVE, sim_arena);
+  velocity_field = velocity_buffer->front();
   for(int i = 0; i < N_ROWS; i++)
     for(int j = 0; j < N_COLS; j++)
-      velocity_field->index(i, j) = {0, 0};
+      velocity_field->set(i, j, {0, 0});
   velocity_field->update_boundary();
+
+  divergence_field = new sim_field_t(DONTCARE, sim_arena);
+  pressure_field = new sim_field_t(CLONE, sim_arena);
+  color_backtrace = new Backtrace(N_ROWS, N_COLS, sim_arena);
+  #ifdef MULTIGRID
+  multigrid = new Multigrid<sim_scalar_t>(N_ROWS, N_COLS, sim_arena);
+  #endif
   
   
   // Init the raw fields using rules, then smooth them with the kernel for the final color fields
 
   Serial.println("Initializing color fields...");
   float kernel[3][3] = {{1/16.0, 1/8.0, 1/16.0}, {1/8.0, 1/4.0, 1/8.0}, {1/16.0, 1/8.0, 1/16.0}};
-  red_field = new Field<iram_float_t>(N_ROWS, N_COLS, CLONE);
-  green_field = new Field<iram_float_t>(N_ROWS, N_COLS, CLONE);
-  blue_field = new Field<iram_float_t>(N_ROWS, N_COLS, CLONE);
+  red_field = new dye_field_t(CLONE, dye_arena);
+  green_field = new dye_field_t(CLONE, dye_arena);
+  blue_field = new dye_field_t(CLONE, dye_arena);
+  color_scratch_field = new dye_field_t(CLONE, dye_arena);
+  check_arenas();
 
   const int center_i = N_ROWS/2, center_j = N_COLS/2;
   for(int i = 0; i < N_ROWS; i++){
@@ -396,9 +685,9 @@ void setup(void) {
           if(ii > N_ROWS-1) ii = N_ROWS-1;
           if(jj > N_COLS-1) jj = N_COLS-1;
           
-          smoothed_red += kernel[di][dj]*red_field->index(ii, jj);
-          smoothed_green += kernel[di][dj]*green_field->index(ii, jj);
-          smoothed_blue += kernel[di][dj]*blue_field->index(ii, jj);
+          smoothed_red += kernel[di][dj]*(float)red_field->index(ii, jj);
+          smoothed_green += kernel[di][dj]*(float)green_field->index(ii, jj);
+          smoothed_blue += kernel[di][dj]*(float)blue_field->index(ii, jj);
         }
       }
 
@@ -412,12 +701,17 @@ void setup(void) {
   blue_field->update_boundary();
 
 
+  report_memory();
+
+
   Serial.println("Launching tasks...");
   xSemaphoreGive(color_consumed); // start with a write not a read
   xSemaphoreGive(stats_consumed);
   xTaskCreate(draw_routine, "draw", 2000, NULL, configMAX_PRIORITIES-1, NULL);
   xTaskCreate(touch_routine, "touch", 2000, NULL, configMAX_PRIORITIES-2, NULL);
-  xTaskCreate(sim_routine, "sim", 2000, NULL, configMAX_PRIORITIES-3, NULL);
+  // The sim runs on core 1 and splits its operations with a worker on core 0 (see parallel.h)
+  parallel_begin(0, configMAX_PRIORITIES-3);
+  xTaskCreatePinnedToCore(sim_routine, "sim", 2000, NULL, configMAX_PRIORITIES-3, NULL, 1);
   xTaskCreate(stats_routine, "stats", 2000, NULL, configMAX_PRIORITIES-4, NULL);
 
 
@@ -1,74 +1,243 @@
 #ifndef OPERATIONS_H
 #define OPERATIONS_H
 
+#include <math.h>
+
 #include "Vector.h"
 #include "Field.h"
+#include "VectorField.h"
+#include "Fixed.h"
+#include "iram_float.h"
+#include "unorm8.h"
+#include "parallel.h"
 
 #define FLOOR(x) ( x < 0 ? int(x)-1 : int(x) )
 
 // The below operations assume that the input and output have the same shape
 // SCALAR_T and VECTOR_T are self-evident template args, but T means here that either a scalar or vector can be used
+// They are written once for both float and Fixed fields, so they only rely on +, -, * between 
+//  values of the same type, and * and / by ints
+// Each splits its rows across both cores with parallel_for, then updates the boundary once both 
+//  halves are done
+
+// The type of the interpolation weights for a T, i.e. what a T can be multiplied by
+template<class T> struct interp_weight{ typedef T type; };
+template<> struct interp_weight<iram_float_t>{ typedef float type; };
+template<class S> struct interp_weight<Vector<S>>{ typedef S type; };
+template<> struct interp_weight<unorm8_t>{ typedef q8_8_t type; };
+
+inline int floor_to_int(float x){ return FLOOR(x); }
+
+template<int FRAC, class STORAGE_T, class WIDE_T>
+inline int floor_to_int(const Fixed<FRAC, STORAGE_T, WIDE_T> &x){ return x.floor(); }
+
+// Interpolation weights from 0 to 1 (exclusive) kept in 8 bits, i.e. in 1/256ths, and back
+inline uint8_t weight_to_byte(float x){ return x*256; }
+
+template<int FRAC, class STORAGE_T, class WIDE_T>
+inline uint8_t weight_to_byte(const Fixed<FRAC, STORAGE_T, WIDE_T> &x){ return x.raw >> (FRAC-8); }
+
+template<class WEIGHT_T> struct weight_from_byte{
+    static float convert(uint8_t w){ return w*(1.0f/256); }
+};
+template<int FRAC, class STORAGE_T, class WIDE_T> struct weight_from_byte<Fixed<FRAC, STORAGE_T, WIDE_T>>{
+    static Fixed<FRAC, STORAGE_T, WIDE_T> convert(uint8_t w){ 
+        return Fixed<FRAC, STORAGE_T, WIDE_T>::from_raw((STORAGE_T)w << (FRAC-8)); 
+    }
+};
 
-template<class T>
-T billinear_interpolate(float di, float dj, T p11, T p12, T p21, T p22)
+// Each lerp is written as a+(b-a)*d, which takes one multiply instead of two and, with Fixed weights 
+//  (where it's done entirely in integer arithmetic), returns a constant exactly instead of rounding it twice
+template<class T, class WEIGHT_T>
+T billinear_interpolate(WEIGHT_T di, WEIGHT_T dj, T p11, T p12, T p21, T p22)
 {
     T x1, x2, interpolated;
-    x1 = p11*(1-dj)+p12*dj; // interp between lower-left and upper-left
-    x2 = p21*(1-dj)+p22*dj; // interp between lower-right and upper-right
-    interpolated = x1*(1-di)+x2*di; // interp between left and right
+    x1 = p11+(p12-p11)*dj; // interp between lower-left and upper-left
+    x2 = p21+(p22-p21)*dj; // interp between lower-right and upper-right
+    interpolated = x1+(x2-x1)*di; // interp between left and right
     return interpolated;
 }
 
-template<class T, class VECTOR_T>
-void semilagrangian_advect(Field<T> *new_property, const Field<T> *property, const Field<VECTOR_T> *velocity, float dt){
+// The same for unorm8_t, but entirely in int: each lerp along j keeps 8 more fractional bits (from 
+//  the weight) instead of rounding, and only the final one rounds back to a byte
+inline unorm8_t billinear_interpolate(q8_8_t di, q8_8_t dj, unorm8_t p11, unorm8_t p12, unorm8_t p21, unorm8_t p22)
+{
+    int x1, x2, interpolated;
+    x1 = (p11.raw << 8)+(p12.raw-p11.raw)*dj.raw; // interp between lower-left and upper-left
+    x2 = (p21.raw << 8)+(p22.raw-p21.raw)*dj.raw; // interp between lower-right and upper-right
+    interpolated = ((x1 << 8)+(x2-x1)*di.raw+(1 << 15)) >> 16; // interp between left and right
+    return unorm8_t::from_raw(interpolated);
+}
+
+// Traces the cell (i, j) back along the velocity (u, v) for dt, clamps where it lands within the 
+//  boundaries, and splits that into the cell at its lower-left and how far past it it is
+template<class COORD_T>
+inline void backtrace(int i, int j, COORD_T u, COORD_T v, COORD_T dt, COORD_T max_i, COORD_T max_j,
+    int &i11, int &j11, COORD_T &di, COORD_T &dj)
+{
+    const COORD_T min_coord = -0.5f;
+    COORD_T source_i = i-u*dt, source_j = j-v*dt;
+
+    // Clamp the source location within the boundaries
+    if(source_i < min_coord) source_i = min_coord;
+    if(source_i > max_i) source_i = max_i;
+    if(source_j < min_coord) source_j = min_coord;
+    if(source_j > max_j) source_j = max_j;
+
+    i11 = floor_to_int(source_i);
+    j11 = floor_to_int(source_j);
+    di = source_i-i11;
+    dj = source_j-j11;
+}
+
+template<class T, class VECTOR_T, int NI, int NJ>
+void semilagrangian_advect(Field<T, NI, NJ> *new_property, const Field<T, NI, NJ> *property, const Field<VECTOR_T, NI, NJ> *velocity, float dt){
+    typedef decltype(VECTOR_T::x) COORD_T;
+    typedef typename interp_weight<T>::type WEIGHT_T;
+
     int N_i = new_property->N_i, N_j = new_property->N_j;
-    for(int i = 0; i < N_i; i++){
-        for(int j = 0; j < N_j; j++){
-            VECTOR_T displacement = dt*velocity->index(i, j);
-            VECTOR_T source = {i-displacement.x, j-displacement.y};
-
-            // Clamp the source location within the boundaries
-            if(source.x < -0.5f) source.x = -0.5f;
-            if(source.x > N_i-0.5f) source.x = N_i-0.5f;
-            if(source.y < -0.5f) source.y = -0.5f;
-            if(source.y > N_j-0.5f) source.y = N_j-0.5f;
-
-            // Get the source value with billinear interpolation
-            int i11 = FLOOR(source.x), j11 = FLOOR(source.y), 
-                i12 = i11, j12 = j11+1, 
-                i21 = i11+1, j21 = j11, 
-                i22 = i11+1, j22 = j11+1;
-            float di = source.x-i11, dj = source.y-j11;
-            T p11 = property->index(i11, j11), p12 = property->index(i12, j12),
-                p21 = property->index(i21, j21), p22 = property->index(i22, j22);
-            T interpolated = billinear_interpolate(di, dj, p11, p12, p21, p22);
-            new_property->index(i, j) = interpolated;
+    const COORD_T dt_coord = dt, max_i = N_i-0.5f, max_j = N_j-0.5f;
+    parallel_for(0, N_i, [&](int i_begin, int i_end){
+        for(int i = i_begin; i < i_end; i++){
+            for(int j = 0; j < N_j; j++){
+                VECTOR_T v = velocity->index(i, j);
+                int i11, j11;
+                COORD_T di, dj;
+                backtrace(i, j, v.x, v.y, dt_coord, max_i, max_j, i11, j11, di, dj);
+
+                // Get the source value with billinear interpolation
+                new_property->index(i, j) = billinear_interpolate(WEIGHT_T(di), WEIGHT_T(dj),
+                    property->index(i11, j11), property->index(i11, j11+1),
+                    property->index(i11+1, j11), property->index(i11+1, j11+1));
+            }
         }
-    }
+    });
+    new_property->update_boundary();
+}
+
+// The same, but with a VectorField velocity. Since its planes have the same shape as the property, 
+//  one offset indexes all of them.
+template<class T, class COORD_T, int NI, int NJ>
+void semilagrangian_advect(Field<T, NI, NJ> *new_property, const Field<T, NI, NJ> *property, const VectorField<COORD_T, NI, NJ> *velocity, float dt){
+    typedef typename interp_weight<T>::type WEIGHT_T;
+
+    int N_i = new_property->N_i, N_j = new_property->N_j, stride = property->row_stride();
+    const COORD_T dt_coord = dt, max_i = N_i-0.5f, max_j = N_j-0.5f;
+    const COORD_T *u = velocity->x.data(), *v = velocity->y.data();
+    const T *p = property->data();
+    T *new_p = new_property->data();
+    parallel_for(0, N_i, [&](int i_begin, int i_end){
+        for(int i = i_begin; i < i_end; i++){
+            int row = property->offset(i, 0);
+            for(int j = 0; j < N_j; j++){
+                int k = row+j, i11, j11;
+                COORD_T di, dj;
+                backtrace(i, j, u[k], v[k], dt_coord, max_i, max_j, i11, j11, di, dj);
+
+                int k11 = property->offset(i11, j11);
+                new_p[k] = billinear_interpolate(WEIGHT_T(di), WEIGHT_T(dj),
+                    p[k11], p[k11+1], p[k11+stride], p[k11+stride+1]);
+            }
+        }
+    });
+    new_property->update_boundary();
+}
+
+// And a VectorField property, which traces back once for both planes
+template<class COORD_T, int NI, int NJ>
+void semilagrangian_advect(VectorField<COORD_T, NI, NJ> *new_property, const VectorField<COORD_T, NI, NJ> *property, const VectorField<COORD_T, NI, NJ> *velocity, float dt){
+    int N_i = new_property->N_i, N_j = new_property->N_j, stride = property->x.row_stride();
+    const COORD_T dt_coord = dt, max_i = N_i-0.5f, max_j = N_j-0.5f;
+    const COORD_T *u = velocity->x.data(), *v = velocity->y.data(), 
+        *x = property->x.data(), *y = property->y.data();
+    COORD_T *new_x = new_property->x.data(), *new_y = new_property->y.data();
+    parallel_for(0, N_i, [&](int i_begin, int i_end){
+        for(int i = i_begin; i < i_end; i++){
+            int row = property->x.offset(i, 0);
+            for(int j = 0; j < N_j; j++){
+                int k = row+j, i11, j11;
+                COORD_T di, dj;
+                backtrace(i, j, u[k], v[k], dt_coord, max_i, max_j, i11, j11, di, dj);
+
+                int k11 = property->x.offset(i11, j11);
+                new_x[k] = billinear_interpolate(di, dj, x[k11], x[k11+1], x[k11+stride], x[k11+stride+1]);
+                new_y[k] = billinear_interpolate(di, dj, y[k11], y[k11+1], y[k11+stride], y[k11+stride+1]);
+            }
+        }
+    });
     new_property->update_boundary();
 }
 
-template<class SCALAR_T, class VECTOR_T>
-void divergence(Field<SCALAR_T> *del_dot_velocity, const Field<VECTOR_T> *velocity){
+template<class SCALAR_T, class VECTOR_T, int NI, int NJ>
+void divergence(Field<SCALAR_T, NI, NJ> *del_dot_velocity, const Field<VECTOR_T, NI, NJ> *velocity){
     int N_i = del_dot_velocity->N_i, N_j = del_dot_velocity->N_j;
     
-    for(int i = 0; i < N_i; i++){
-        for(int j = 0; j < N_j; j++){
-            SCALAR_T leftflow, rightflow, downflow, upflow;
-            leftflow = -velocity->index(i-1, j).x;
-            rightflow = velocity->index(i+1, j).x;
-            downflow = -velocity->index(i, j-1).y;
-            upflow = velocity->index(i, j+1).y;
+    parallel_for(0, N_i, [&](int i_begin, int i_end){
+        for(int i = i_begin; i < i_end; i++){
+            for(int j = 0; j < N_j; j++){
+                SCALAR_T leftflow, rightflow, downflow, upflow;
+                leftflow = -velocity->index(i-1, j).x;
+                rightflow = velocity->index(i+1, j).x;
+                downflow = -velocity->index(i, j-1).y;
+                upflow = velocity->index(i, j+1).y;
 
-            del_dot_velocity->index(i, j) = (upflow+downflow+leftflow+rightflow)/2;
+                del_dot_velocity->index(i, j) = (upflow+downflow+leftflow+rightflow)/2;
+            }
         }
-    }
+    });
+
+    del_dot_velocity->update_boundary();
+}
+
+template<class SCALAR_T, int NI, int NJ>
+void divergence(Field<SCALAR_T, NI, NJ> *del_dot_velocity, const VectorField<SCALAR_T, NI, NJ> *velocity){
+    int N_i = del_dot_velocity->N_i, N_j = del_dot_velocity->N_j, stride = del_dot_velocity->row_stride();
+    const SCALAR_T *x = velocity->x.data(), *y = velocity->y.data();
+    SCALAR_T *div = del_dot_velocity->data();
+    
+    parallel_for(0, N_i, [&](int i_begin, int i_end){
+        for(int i = i_begin; i < i_end; i++){
+            int row = del_dot_velocity->offset(i, 0);
+            for(int k = row; k < row+N_j; k++)
+                div[k] = (y[k+1]-y[k-1]-x[k-stride]+x[k+stride])/2;
+        }
+    });
 
     del_dot_velocity->update_boundary();
 }
 
-template<class SCALAR_T>
-void sor_pressure(Field<SCALAR_T> *pressure, const Field<SCALAR_T> *divergence, int iterations, float omega){
+// Runs SOR iterations on the pressure as it is, so it can also refine a guess (e.g. in Multigrid.h)
+// The cells are updated in red-black (checkerboard) order: all the cells where i+j is even, then all 
+//  the odd ones. Each only reads neighbors of the other color, so each color can be split by rows.
+template<class SCALAR_T, int NI, int NJ>
+void sor_iterate(Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T, NI, NJ> *divergence, int iterations, float omega){
+    int N_i = pressure->N_i, N_j = pressure->N_j;
+    const SCALAR_T relaxation = omega, retention = 1-omega;
+
+    for(int k = 0; k < iterations; k++){
+        for(int color = 0; color < 2; color++){
+            parallel_for(0, N_i, [&](int i_begin, int i_end){
+                for(int i = i_begin; i < i_end; i++){
+                    for(int j = (i+color)%2; j < N_j; j += 2){
+                        SCALAR_T div = divergence->index(i, j);
+                        SCALAR_T left, right, down, up;
+                        left = pressure->index(i-1, j);
+                        right = pressure->index(i+1, j);
+                        down = pressure->index(i, j-1);
+                        up = pressure->index(i, j+1);
+
+                        pressure->index(i, j) = retention*pressure->index(i, j) + relaxation*(div-left-right-down-up)/(-4);
+                    }
+                }
+            });
+        }
+
+        pressure->update_boundary();
+    }
+}
+
+template<class SCALAR_T, int NI, int NJ>
+void sor_pressure(Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T, NI, NJ> *divergence, int iterations, float omega){
     int N_i = pressure->N_i, N_j = pressure->N_j;
 
     for(int i = 0; i < N_i; i++)
@@ -77,42 +246,215 @@ void sor_pressure(Field<SCALAR_T> *pressure, const Field<SCALAR_T> *divergence,
     
     pressure->update_boundary();
 
-    for(int k = 0; k < iterations; k++){
-        for(int i = 0; i < N_i; i++){
+    sor_iterate(pressure, divergence, iterations, omega);
+}
+
+// The worst (absolute) residual of the pressure equation over the domain, i.e. how far the pressure 
+//  is from solving it
+template<class SCALAR_T, int NI, int NJ>
+float pressure_residual(const Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T, NI, NJ> *divergence){
+    int N_i = pressure->N_i, N_j = pressure->N_j;
+    float worst = 0;
+
+    for(int i = 0; i < N_i; i++){
+        for(int j = 0; j < N_j; j++){
+            SCALAR_T laplacian = pressure->index(i-1, j)+pressure->index(i+1, j)
+                +pressure->index(i, j-1)+pressure->index(i, j+1)-pressure->index(i, j)*4;
+            float residual = fabsf((float)(divergence->index(i, j)-laplacian));
+            if(residual > worst) worst = residual;
+        }
+    }
+
+    return worst;
+}
+
+// Scales the pressure toward zero before a solve. A carry_over of 0 starts from zero like sor_pressure, 
+//  and 1 starts from the pressure as it is, i.e. the last frame's, which is already close to this 
+//  frame's since the pressure changes slowly.
+template<class SCALAR_T, int NI, int NJ>
+void carry_over_pressure(Field<SCALAR_T, NI, NJ> *pressure, float carry_over){
+    int N_i = pressure->N_i, N_j = pressure->N_j;
+    const SCALAR_T factor = carry_over;
+    if(carry_over == 1) return; // e.g. divergence_and_carry_over already did it
+
+    for(int i = 0; i < N_i; i++)
+        for(int j = 0; j < N_j; j++)
+            pressure->index(i, j) = (carry_over == 0)? SCALAR_T(0) : pressure->index(i, j)*factor;
+    
+    pressure->update_boundary();
+}
+
+// The divergence of the velocity and carry_over_pressure in one pass over the rows instead of two, 
+//  since neither reads what the other writes. Returns the worst (absolute) divergence, which is 
+//  what the pressure solve would start from, so a still fluid can skip the solve altogether.
+template<class SCALAR_T, int NI, int NJ>
+float divergence_and_carry_over(Field<SCALAR_T, NI, NJ> *del_dot_velocity, const VectorField<SCALAR_T, NI, NJ> *velocity, 
+        Field<SCALAR_T, NI, NJ> *pressure, float carry_over){
+    int N_i = del_dot_velocity->N_i, N_j = del_dot_velocity->N_j, stride = del_dot_velocity->row_stride();
+    const SCALAR_T *x = velocity->x.data(), *y = velocity->y.data();
+    SCALAR_T *div = del_dot_velocity->data(), *p = pressure->data();
+    const SCALAR_T factor = carry_over;
+    float band_worst[PARALLEL_BANDS] = {0};
+    
+    parallel_for(0, N_i, [&](int i_begin, int i_end){
+        float &worst = band_worst[parallel_band(0, i_begin)];
+        for(int i = i_begin; i < i_end; i++){
+            int row = del_dot_velocity->offset(i, 0);
+            for(int k = row; k < row+N_j; k++){
+                div[k] = (y[k+1]-y[k-1]-x[k-stride]+x[k+stride])/2;
+                float magnitude = fabsf((float)div[k]);
+                if(magnitude > worst) worst = magnitude;
+                p[k] = (carry_over == 0)? SCALAR_T(0) : p[k]*factor;
+            }
+        }
+    });
+
+    del_dot_velocity->update_boundary();
+    pressure->update_boundary();
+
+    float worst = 0;
+    for(int band = 0; band < PARALLEL_BANDS; band++)
+        if(band_worst[band] > worst) worst = band_worst[band];
+    return worst;
+}
+
+// Runs SOR iterations on the pressure as it is in batches of check_period, and stops after a batch 
+//  once the worst residual is under tolerance or there have been max_iterations. Each check is a 
+//  pass over the grid too, hence the batches. If final_residual isn't NULL, the worst residual at 
+//  the end is written to it, which can take one more check. Returns how many iterations it ran.
+template<class SCALAR_T, int NI, int NJ>
+int sor_iterate_until(Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T, NI, NJ> *divergence, 
+        int max_iterations, float omega, float tolerance, int check_period, float *final_residual = NULL){
+    int iterations = 0;
+    float residual = -1; // i.e. not checked yet
+    while(iterations < max_iterations && (residual < 0 || residual >= tolerance)){
+        int batch = (max_iterations-iterations < check_period)? max_iterations-iterations : check_period;
+        sor_iterate(pressure, divergence, batch, omega);
+        iterations += batch;
+        residual = (iterations < max_iterations || final_residual != NULL)? 
+            pressure_residual(pressure, divergence) : -1;
+    }
+
+    if(final_residual != NULL) *final_residual = (residual < 0)? pressure_residual(pressure, divergence) : residual;
+    return iterations;
+}
+
+// Like sor_pressure, but stops before max_iterations once the worst residual is under tolerance. 
+//  It's checked before the first iteration (which catches a still fluid right away) and then as 
+//  sor_iterate_until does. The pressure starts from what carry_over_pressure leaves. Returns how 
+//  many iterations it ran.
+template<class SCALAR_T, int NI, int NJ>
+int sor_pressure_until(Field<SCALAR_T, NI, NJ> *pressure, const Field<SCALAR_T, NI, NJ> *divergence, 
+        int max_iterations, float omega, float tolerance, int check_period, float carry_over = 0, 
+        float *final_residual = NULL){
+    carry_over_pressure(pressure, carry_over);
+
+    float residual = pressure_residual(pressure, divergence);
+    if(residual < tolerance){
+        if(final_residual != NULL) *final_residual = residual;
+        return 0;
+    }
+    return sor_iterate_until(pressure, divergence, max_iterations, omega, tolerance, check_period, final_residual);
+}
+
+template<class SCALAR_T, class VECTOR_T, int NI, int NJ>
+void gradient_and_subtract(Field<VECTOR_T, NI, NJ> *velocity, const Field<SCALAR_T, NI, NJ> *pressure){
+    int N_i = velocity->N_i, N_j = velocity->N_j;
+    
+    parallel_for(0, N_i, [&](int i_begin, int i_end){
+        for(int i = i_begin; i < i_end; i++){
             for(int j = 0; j < N_j; j++){
-                SCALAR_T div = divergence->index(i, j);
                 SCALAR_T left, right, down, up;
                 left = pressure->index(i-1, j);
                 right = pressure->index(i+1, j);
                 down = pressure->index(i, j-1);
                 up = pressure->index(i, j+1);
 
-                pressure->index(i, j) = (1-omega)*pressure->index(i, j) + omega*(div-left-right-down-up)/(-4);
+                velocity->index(i, j).x -= (right-left)/2;
+                velocity->index(i, j).y -= (up-down)/2;
             }
         }
+    });
 
-        pressure->update_boundary();
-    }
+    velocity->update_boundary();
 }
 
-template<class SCALAR_T, class VECTOR_T>
-void gradient_and_subtract(Field<VECTOR_T> *velocity, const Field<SCALAR_T> *pressure){
-    int N_i = velocity->N_i, N_j = velocity->N_j;
+template<class SCALAR_T, int NI, int NJ>
+void gradient_and_subtract(VectorField<SCALAR_T, NI, NJ> *velocity, const Field<SCALAR_T, NI, NJ> *pressure){
+    int N_i = velocity->N_i, N_j = velocity->N_j, stride = pressure->row_stride();
+    SCALAR_T *x = velocity->x.data(), *y = velocity->y.data();
+    const SCALAR_T *p = pressure->data();
     
-    for(int i = 0; i < N_i; i++){
-        for(int j = 0; j < N_j; j++){
-            SCALAR_T left, right, down, up;
-            left = pressure->index(i-1, j);
-            right = pressure->index(i+1, j);
-            down = pressure->index(i, j-1);
-            up = pressure->index(i, j+1);
-
-            velocity->index(i, j).x -= (right-left)/2;
-            velocity->index(i, j).y -= (up-down)/2;
+    parallel_for(0, N_i, [&](int i_begin, int i_end){
+        for(int i = i_begin; i < i_end; i++){
+            int row = pressure->offset(i, 0);
+            for(int k = row; k < row+N_j; k++){
+                x[k] -= (p[k+stride]-p[k-stride])/2;
+                y[k] -= (p[k+1]-p[k-1])/2;
+            }
         }
-    }
+    });
+
+    velocity->update_boundary();
+}
+
+// Like gradient_and_subtract, but also returns the worst (absolute) divergence left in the velocity 
+//  afterwards, i.e. how well the projection worked, without another pass over the grid to find it.
+// The divergence of a row needs the rows on either side of it subtracted (and its own side 
+//  boundaries updated), so each band finds it one row behind the subtraction, while all three rows 
+//  are still at hand. That leaves the first and last row of each band, which need a row from the 
+//  other band or the top or bottom boundary, for once both bands and the boundary are done.
+template<class SCALAR_T, int NI, int NJ>
+float gradient_and_subtract_max_divergence(VectorField<SCALAR_T, NI, NJ> *velocity, const Field<SCALAR_T, NI, NJ> *pressure){
+    int N_i = velocity->N_i, N_j = velocity->N_j, stride = pressure->row_stride();
+    SCALAR_T *x = velocity->x.data(), *y = velocity->y.data();
+    const SCALAR_T *p = pressure->data();
+    float band_worst[PARALLEL_BANDS] = {0};
+    int band_edges[2*PARALLEL_BANDS];
+    for(int k = 0; k < 2*PARALLEL_BANDS; k++) band_edges[k] = -1;
+
+    auto row_divergence = [&](int i){
+        int row = pressure->offset(i, 0);
+        float worst = 0;
+        for(int k = row; k < row+N_j; k++){
+            float magnitude = fabsf((float)((y[k+1]-y[k-1]-x[k-stride]+x[k+stride])/2));
+            if(magnitude > worst) worst = magnitude;
+        }
+        return worst;
+    };
+    
+    parallel_for(0, N_i, [&](int i_begin, int i_end){
+        int band = parallel_band(0, i_begin);
+        float &worst = band_worst[band];
+        for(int i = i_begin; i < i_end; i++){
+            int row = pressure->offset(i, 0);
+            for(int k = row; k < row+N_j; k++){
+                x[k] -= (p[k+stride]-p[k-stride])/2;
+                y[k] -= (p[k+1]-p[k-1])/2;
+            }
+            velocity->x.update_side_boundary(i);
+            velocity->y.update_side_boundary(i);
+
+            if(i-1 > i_begin){
+                float row_worst = row_divergence(i-1);
+                if(row_worst > worst) worst = row_worst;
+            }
+        }
+        band_edges[2*band] = i_begin;
+        band_edges[2*band+1] = i_end-1;
+    });
 
     velocity->update_boundary();
+
+    float worst = 0;
+    for(int band = 0; band < PARALLEL_BANDS; band++)
+        if(band_worst[band] > worst) worst = band_worst[band];
+    for(int k = 0; k < 2*PARALLEL_BANDS; k++){
+        if(band_edges[k] < 0) continue;
+        float row_worst = row_divergence(band_edges[k]);
+        if(row_worst > worst) worst = row_worst;
+    }
+    return worst;
 }
 
 #endif
\ No newline at end of file
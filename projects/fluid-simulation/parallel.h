@@ -0,0 +1,78 @@
+// parallel_for
+// Splits a range of rows into two bands and runs a function on both at the same time, returning once
+//  both are done. The calling task runs the first band, and a worker task pinned to the other core
+//  runs the second. Until parallel_begin() starts the worker (and always off the ESP32, like in the
+//  native tests), the function just runs over the whole range on the calling task.
+// The function is called as function(band_begin, band_end), so writing it as a lambda that loops
+//  over rows band_begin to band_end keeps the loop looking the same as a serial one. It must only
+//  write to its own rows.
+// There is only one worker and one pending job, so parallel_for must only ever be called from one 
+//  task, and never from inside a function it's running. Both are asserted on the ESP32.
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#ifdef ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+struct parallel_job{
+    void (*run)(const void *function, int begin, int end);
+    const void *function;
+    int begin, end;
+};
+
+static TaskHandle_t parallel_worker = NULL, parallel_caller = NULL;
+static parallel_job parallel_pending; // written before notifying the worker, which is a barrier
+static bool parallel_busy = false; // set while a job is split across both tasks
+
+static void parallel_worker_routine(void *args){
+    while(1){
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        parallel_pending.run(parallel_pending.function, parallel_pending.begin, parallel_pending.end);
+        xTaskNotifyGive(parallel_caller);
+    }
+}
+
+// Starts the worker on the given core, which should be the one the calling task doesn't run on
+inline void parallel_begin(BaseType_t core, UBaseType_t priority){
+    xTaskCreatePinnedToCore(parallel_worker_routine, "parallel", 2000, NULL, priority, &parallel_worker, core);
+}
+#endif
+
+// There are never more than two bands, and the first one always starts at begin, so a function that 
+//  keeps something per band (like a running max, to combine once parallel_for returns) can tell 
+//  which band it's running with this
+#define PARALLEL_BANDS 2
+inline int parallel_band(int begin, int band_begin){ return (band_begin == begin)? 0 : 1; }
+
+template<class FUNCTION_T>
+void parallel_for(int begin, int end, const FUNCTION_T &function){
+    #ifdef ESP32
+    if(parallel_worker != NULL && end-begin > 1){
+        int middle = begin+(end-begin)/2;
+
+        configASSERT(!parallel_busy); // not nested
+        configASSERT(parallel_caller == NULL || parallel_caller == xTaskGetCurrentTaskHandle()); // one caller
+        parallel_busy = true;
+        parallel_caller = xTaskGetCurrentTaskHandle();
+        parallel_pending.run = [](const void *function, int band_begin, int band_end){
+            (*static_cast<const FUNCTION_T*>(function))(band_begin, band_end);
+        };
+        parallel_pending.function = &function;
+        parallel_pending.begin = middle;
+        parallel_pending.end = end;
+        xTaskNotifyGive(parallel_worker);
+
+        function(begin, middle);
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // wait for the worker
+        parallel_busy = false;
+        return;
+    }
+    #endif
+
+    function(begin, end);
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include <SPI.h>
 #include <XPT2046_Touchscreen.h>
 #include <TFT_eSPI.h>
+#include "FastRandom.h"
 
 #define XPT2046_IRQ 36
 #define XPT2046_MOSI 32
@@ -40,6 +41,9 @@ XPT2046_Touchscreen ts(XPT2046_CS, XPT2046_IRQ);
 TFT_eSPI tft = TFT_eSPI();
 boolean loadingflag = true;
 
+// Fixed seed, so every start lays the particles out the same way.
+static FastRandom particleRandom(1);
+
 template <class T>
 class vec2
 {
@@ -239,12 +243,12 @@ public:
     acceleration = PVector(0, 0);
     velocity = PVector(randomf(), randomf());
     location = PVector(x, y);
-    hue = random(0x0A0A0A0A, 0xFFFFFFFF);
+    hue = particleRandom.nextRange(0x0A0A0A0A, 0xFFFFFFFF);
   }
 
   static float randomf()
   {
-    return mapfloat(random(0, 255), 0, 255, -.5, .5);
+    return mapfloat(particleRandom.nextBelow(255), 0, 255, -.5, .5);
   }
 
   static float mapfloat(float x, float in_min, float in_max, float out_min, float out_max)
@@ -313,7 +317,7 @@ uint16_t huecounter = 1;
 
 void start()
 {
-  int direction = random(0, 2);
+  int direction = particleRandom.nextBelow(2);
   if (direction == 0)
     direction = -1;
 
@@ -322,11 +326,11 @@ void start()
 
   for (int i = 0; i < NUM_PARTICLES; i++)
   {
-    Boid boid = Boid(random(1, COLS - 1), random(1, ROWS - 1)); // Full screen
-    // Boid boid = Boid(random(COL_CENTER - ROW_CENTER, COL_CENTER + ROW_CENTER), random(1, ROWS - 1)); // Square in middle
-    boid.velocity.x = ((float)random(40, 50)) / 14.0;
+    Boid boid = Boid(particleRandom.nextRange(1, COLS - 1), particleRandom.nextRange(1, ROWS - 1)); // Full screen
+    // Boid boid = Boid(particleRandom.nextRange(COL_CENTER - ROW_CENTER, COL_CENTER + ROW_CENTER), particleRandom.nextRange(1, ROWS - 1)); // Square in middle
+    boid.velocity.x = ((float)particleRandom.nextRange(40, 50)) / 14.0;
     boid.velocity.x *= direction;
-    boid.velocity.y = ((float)random(40, 50)) / 14.0;
+    boid.velocity.y = ((float)particleRandom.nextRange(40, 50)) / 14.0;
     boid.velocity.y *= direction;
     boid.hue = huecounter;
     huecounter += 0xFABCDE;
@@ -1,10 +1,12 @@
-#include <unordered_map>
-#include <unordered_set>
+// #define SAND_PROFILE // if uncommented, prints per-phase timings to Serial and draws them on screen (see SandProfile.h)
+
 #include <math.h>
 #include <Arduino.h>
 #include "lgfx_8048S043C.h"
-#include "PixelState.h"
+#include "SandEngine.h"
+#include "FastRandom.h"
 #include "colorChangeRoutine.h"
+#include "SandProfile.h"
 
 /////////////////////////////////////////////////////
 // You can adjust the following "subjective" params:
@@ -51,18 +53,16 @@ unsigned long allColorChangeTime = 0;
 int32_t inputX = -1;
 int32_t inputY = -1;
 
-// pixelStates key is a concat of the 16 bit x/y values into a single 32 bit value for more efficient storage.
-std::unordered_map<uint64_t, PointState> pixelStates;          // [X,Y]:[STATE_DATA]
-std::unordered_map<uint64_t, PointState> landedPixelStates;    // [X,Y]:[STATE_DATA]
-std::unordered_map<uint32_t, uint32_t> landedPixelsColumnTops; // [X]:[Y]  // For each column (X), what is the highest row (Y) where a pixel stopped.
-
-static std::unordered_map<uint64_t, PointState> pixelStatesToAdd;
-static std::unordered_set<uint64_t> pixelsToErase;
-
 SemaphoreHandle_t xDisplayMutex = NULL;
-SemaphoreHandle_t xStateMutex = NULL;
 SemaphoreHandle_t xSemaphore1 = NULL;
 SemaphoreHandle_t xSemaphore2 = NULL;
+
+// One generator per task, so the cores share no state. Fixed seeds keep runs repeatable.
+static FastRandom sandRandom(1);
+static FastRandom taskRandom(2);
+
+// Phase of the frame that task1 runs next. Set before xSemaphore1 is given.
+volatile uint8_t movePhase = 0;
 SemaphoreHandle_t xSemaphore3 = NULL;
 SemaphoreHandle_t xSemaphore4 = NULL;
 
@@ -97,18 +97,28 @@ void setColor(uint8_t *rgbValues, uint8_t _red, uint8_t _green, uint8_t _blue)
   rgbValues[2] = _blue;  /// * `rgbValues[2]` is the blue value
 }
 
-Point getXYIndividualValues(uint64_t xy)
+// The engine keeps each pixel's color as RGB565, which is the same 5/6/5 bit layout used by rgbValues.
+uint16_t packRgb(const uint8_t *rgbValues)
 {
-  // The 16 bit x/y values are stored as one 32 bit concatenation. Get the individual x/y values.
-  uint32_t pixelXCol = (uint32_t)((xy & 0xFFFF0000) >> 16);
-  uint32_t pixelYRow = (uint32_t)(xy & 0x0000FFFF);
+  return rgbValues[0] << 11 | rgbValues[1] << 5 | rgbValues[2];
+}
 
-  return Point(pixelXCol, pixelYRow);
+void unpackRgb(uint16_t color, uint8_t *rgbValues)
+{
+  setColor(rgbValues, color >> 11, (color >> 5) & 0x3F, color & 0x1F);
 }
 
-uint64_t getXYCombinedValue(uint32_t x, uint32_t y)
+// The shape goes in the low nibble of the engine's per-pixel Aux byte, and the color state in the high nibble.
+uint8_t packAux(uint8_t shape, uint8_t colorState)
 {
-  return ((uint64_t)x << 16) | (uint64_t)(y);
+  return colorState << 4 | (shape & 0x0F);
+}
+
+// Takes the display mutex, which both cores draw under.
+bool takeDisplayMutex()
+{
+  SAND_PROFILE_SCOPE(SAND_TIMER_WAIT_DISPLAY);
+  return xSemaphoreTake(xDisplayMutex, portMAX_DELAY);
 }
 
 void clearScaledPixel(int32_t x, int32_t y)
@@ -117,8 +127,9 @@ void clearScaledPixel(int32_t x, int32_t y)
   int32_t scaledXCol = x * PIXEL_WIDTH;
   int32_t scaledYRow = y * PIXEL_WIDTH;
 
-  if (xSemaphoreTake(xDisplayMutex, portMAX_DELAY))
+  if (takeDisplayMutex())
   {
+    SAND_PROFILE_SCOPE(SAND_TIMER_DRAW);
     display.fillRect(scaledXCol, scaledYRow, PIXEL_WIDTH, PIXEL_WIDTH, BACKGROUND_COLOR);
     xSemaphoreGive(xDisplayMutex);
   }
@@ -126,7 +137,7 @@ void clearScaledPixel(int32_t x, int32_t y)
 
 uint8_t getRandomShape()
 {
-  return random(0, 8);
+  return sandRandom.nextBelow(8);
 }
 
 uint8_t getPixelShape()
@@ -149,8 +160,9 @@ void drawScaledPixel(int32_t x, int32_t y, uint8_t *rgbValues, uint8_t shape)
   uint8_t g = map(rgbValues[1], 0, 63, 0, 255);
   uint8_t b = map(rgbValues[2], 0, 31, 0, 255);
 
-  if (xSemaphoreTake(xDisplayMutex, portMAX_DELAY))
+  if (takeDisplayMutex())
   {
+    SAND_PROFILE_SCOPE(SAND_TIMER_DRAW);
     display.setColor(r, g, b);
 
     // Serial.printf("drawScaledPixel: color:  %02hhX %02hhX %02hhX", r, g, b);
@@ -221,189 +233,52 @@ void drawScaledPixel(int32_t x, int32_t y, uint8_t *rgbValues, uint8_t shape)
   }
 }
 
-void setNextColorAll(std::unordered_map<uint64_t, PointState>::iterator landedPixelStatesBegin,
-                     std::unordered_map<uint64_t, PointState>::iterator landedPixelStatesEnd,
-                     std::unordered_map<uint64_t, PointState>::iterator pixelStatesBegin,
-                     std::unordered_map<uint64_t, PointState>::iterator pixelStatesEnd)
+// Draws the pixels moved by the sand engine.
+class LgfxDrawSink : public SandDrawSink
 {
-  for (auto iter = landedPixelStatesBegin; iter != landedPixelStatesEnd; iter++)
+public:
+  void drawCell(int16_t x, int16_t y, uint16_t color, uint8_t aux) override
   {
-    setNextColor(iter->second.RgbValues, iter->second.ColorState);
-    drawScaledPixel(iter->second.XCol, iter->second.YRow, iter->second.RgbValues, iter->second.Shape);
+    uint8_t rgbValues[3];
+    unpackRgb(color, rgbValues);
+    drawScaledPixel(x, y, rgbValues, aux & 0x0F);
   }
 
-  for (auto iter = pixelStatesBegin; iter != pixelStatesEnd; iter++)
+  void clearCell(int16_t x, int16_t y) override
   {
-    setNextColor(iter->second.RgbValues, iter->second.ColorState);
-    drawScaledPixel(iter->second.XCol, iter->second.YRow, iter->second.RgbValues, iter->second.Shape);
+    clearScaledPixel(x, y);
   }
-}
+};
 
-bool isPixelSlotAvailable(uint64_t xy)
-{
-  auto point = getXYIndividualValues(xy);
-  return withinScaledRows(point.YRow) && withinScaledCols(point.XCol) && pixelStates.find(xy) == pixelStates.end() && point.YRow < landedPixelsColumnTops[point.XCol];
-}
+static LgfxDrawSink drawSink;
+static SandEngine<SCALED_COLS, SCALED_ROWS> sand(drawSink, gravity);
 
-void updateLandedPixelsColumnTops(uint64_t xyLanded)
+// Step the color of every pixel in columns [xColBegin, xColEnd), landed or not, and redraw it.
+void setNextColorAll(int32_t xColBegin, int32_t xColEnd)
 {
-  // landedPixelsColumnTops stores the highest row (Y) where a pixel stopped for each column (X).
-
-  auto point = getXYIndividualValues(xyLanded);
+  SAND_PROFILE_SCOPE(SAND_TIMER_COLOR_CHANGE);
 
-  landedPixelsColumnTops[point.XCol] = std::min(landedPixelsColumnTops[point.XCol], point.YRow);
-}
-
-bool canPixelFall(uint64_t xyKey)
-{
-  // The 16 bit x/y values are stored as one 32 bit concatenation. Get the individual x/y values.
-  uint32_t pixelYRow = (uint32_t)(xyKey & 0x0000FFFF);
-
-  uint32_t pixelYRowNext = pixelYRow + 1;
-
-  if (!withinScaledRows(pixelYRowNext))
-    return false;
-
-  uint32_t pixelXCol = (uint32_t)((xyKey & 0xFFFF0000) >> 16);
-  uint32_t pixelXColMinus = pixelXCol - 1;
-  uint32_t pixelXColPlus = pixelXCol + 1;
-
-  return (withinScaledCols(pixelXColMinus) && landedPixelsColumnTops[pixelXColMinus] > pixelYRowNext) ||
-         (withinScaledCols(pixelXCol) && landedPixelsColumnTops[pixelXCol] > pixelYRowNext) ||
-         (withinScaledCols(pixelXColPlus) && landedPixelsColumnTops[pixelXColPlus] > pixelYRowNext);
-}
+  auto &grid = sand.getGrid();
+  uint8_t rgbValues[3];
 
-void movePixels(std::unordered_map<uint64_t, PointState>::iterator _pixelStatesIteratorBegin, std::unordered_map<uint64_t, PointState>::iterator _pixelStatesIteratorEnd)
-{
-  // Iterate moving pixels and move them as needed.
-  for (auto iter = _pixelStatesIteratorBegin; iter != _pixelStatesIteratorEnd; iter++)
+  for (int32_t yRow = 0; yRow < SCALED_ROWS; yRow++)
   {
-    auto keyVal = *iter;
-    auto pixelKey = keyVal.first;
-    auto thisPixelState = keyVal.second;
-
-    // The 16 bit x/y values are stored as one 32 bit concatenation. Get the individual x/y values.
-    auto pixelPoint = getXYIndividualValues(pixelKey);
-    uint32_t pixelXCol = pixelPoint.XCol;
-    uint32_t pixelYRow = pixelPoint.YRow;
-
-    auto pixelState = keyVal.second.State;
-    if (pixelState == GRID_STATE_NEW)
+    for (int32_t xCol = xColBegin; xCol < xColEnd; xCol++)
     {
-      pixelStates[pixelKey].State = GRID_STATE_FALLING;
-      continue;
-    }
-
-    uint8_t *thisPixelRgbValues = thisPixelState.RgbValues;
-
-    auto pixelColorState = thisPixelState.ColorState;
-    auto pixelVelocity = thisPixelState.Velocity;
-    auto pixelShape = thisPixelState.Shape;
-
-    bool moved = false;
-
-    uint32_t newMaxYRowPos = uint32_t(pixelYRow + pixelVelocity);
-    for (int32_t yRowPos = newMaxYRowPos; yRowPos > pixelYRow; yRowPos--)
-    {
-      if (!withinScaledRows(yRowPos))
-      {
+      if (grid.getState(xCol, yRow) == GRID_STATE_EMPTY)
         continue;
-      }
-
-      uint64_t belowXY = getXYCombinedValue(pixelXCol, yRowPos);
-
-      int32_t direction = 1;
-      if (random(100) < 50)
-      {
-        direction *= -1;
-      }
-
-      uint32_t belowXY_A = -1;
-      uint32_t belowXY_A_XCol = pixelXCol + direction;
-      uint32_t belowXY_B = -1;
-      uint32_t belowXY_B_XCol = pixelXCol - direction;
-
-      if (withinScaledCols(belowXY_A_XCol))
-      {
-        belowXY_A = getXYCombinedValue(belowXY_A_XCol, yRowPos);
-      }
-      if (withinScaledCols(belowXY_B_XCol))
-      {
-        belowXY_B = getXYCombinedValue(belowXY_B_XCol, yRowPos);
-      }
-
-      if (xSemaphoreTake(xStateMutex, portMAX_DELAY))
-      {
-        if (isPixelSlotAvailable(belowXY) && pixelStatesToAdd.find(belowXY) == pixelStatesToAdd.end())
-        {
-          //    This pixel will go straight down.
-          pixelStatesToAdd[belowXY] = PointState(pixelXCol, yRowPos, GRID_STATE_FALLING, pixelColorState, pixelVelocity + gravity, pixelShape);
-          setColor(&(pixelStatesToAdd[belowXY].RgbValues[0]), thisPixelRgbValues[0], thisPixelRgbValues[1], thisPixelRgbValues[2]);
-
-          clearScaledPixel(pixelXCol, pixelYRow);                              // Out with the old.
-          drawScaledPixel(pixelXCol, yRowPos, thisPixelRgbValues, pixelShape); // In with the new.
-
-          pixelsToErase.insert(pixelKey);
-          pixelsToErase.erase(belowXY);
-
-          moved = true;
-          xSemaphoreGive(xStateMutex);
-          break;
-        }
-        else if (isPixelSlotAvailable(belowXY_A) && pixelStatesToAdd.find(belowXY_A) == pixelStatesToAdd.end())
-        {
-          //  This pixel will fall to side A (right)
-          pixelStatesToAdd[belowXY_A] = PointState(belowXY_A_XCol, yRowPos, GRID_STATE_FALLING, pixelColorState, pixelVelocity + gravity, pixelShape);
-          setColor(&(pixelStatesToAdd[belowXY_A].RgbValues[0]), thisPixelRgbValues[0], thisPixelRgbValues[1], thisPixelRgbValues[2]);
-
-          clearScaledPixel(pixelXCol, pixelYRow);                                   // Out with the old.
-          drawScaledPixel(belowXY_A_XCol, yRowPos, thisPixelRgbValues, pixelShape); // In with the new.
-
-          pixelsToErase.insert(pixelKey);
-          pixelsToErase.erase(belowXY_A);
-
-          moved = true;
-          xSemaphoreGive(xStateMutex);
-          break;
-        }
-        else if (isPixelSlotAvailable(belowXY_B) && pixelStatesToAdd.find(belowXY_B) == pixelStatesToAdd.end())
-        {
-          //  This pixel will fall to side B (left)
-          pixelStatesToAdd[belowXY_B] = PointState(belowXY_B_XCol, yRowPos, GRID_STATE_FALLING, pixelColorState, pixelVelocity + gravity, pixelShape);
-          setColor(&(pixelStatesToAdd[belowXY_B].RgbValues[0]), thisPixelRgbValues[0], thisPixelRgbValues[1], thisPixelRgbValues[2]);
-
-          clearScaledPixel(pixelXCol, pixelYRow);                                   // Out with the old.
-          drawScaledPixel(belowXY_B_XCol, yRowPos, thisPixelRgbValues, pixelShape); // In with the new.
-
-          pixelsToErase.insert(pixelKey);
-          pixelsToErase.erase(belowXY_B);
 
-          moved = true;
-          xSemaphoreGive(xStateMutex);
-          break;
-        }
+      uint8_t aux = grid.getAux(xCol, yRow);
+      uint8_t shape = aux & 0x0F;
+      uint8_t colorState = aux >> 4;
 
-        xSemaphoreGive(xStateMutex);
-      }
-    }
-
-    if (!moved)
-    {
-      thisPixelState.Velocity += gravity;
-    }
-
-    if (xSemaphoreTake(xStateMutex, portMAX_DELAY))
-    {
-      if (!moved && !canPixelFall(pixelKey))
-      {
-        thisPixelState.State = GRID_STATE_LANDED;
-        landedPixelStates[pixelKey] = thisPixelState;
+      unpackRgb(grid.getColor(xCol, yRow), rgbValues);
+      setNextColor(rgbValues, colorState);
 
-        pixelsToErase.insert(pixelKey);
-        updateLandedPixelsColumnTops(pixelKey);
-      }
+      grid.setColor(xCol, yRow, packRgb(rgbValues));
+      grid.setAux(xCol, yRow, packAux(shape, colorState));
 
-      xSemaphoreGive(xStateMutex);
+      drawScaledPixel(xCol, yRow, rgbValues, shape);
     }
   }
 }
@@ -417,11 +292,7 @@ void task1(void *pvParameters)
   {
     if (xSemaphoreTake(xSemaphore1, portMAX_DELAY))
     {
-      auto pixelStatesBegin = pixelStates.begin();
-      auto pixelStatesMid = std::next(pixelStatesBegin, (pixelStates.size() / 2));
-      auto pixelStatesEnd = pixelStates.end();
-
-      movePixels(pixelStatesMid, pixelStatesEnd);
+      sand.moveStripes(movePhase, 1, 2, taskRandom);
 
       xSemaphoreGive(xSemaphore2); // release the mutex
     }
@@ -437,15 +308,7 @@ void task2(void *pvParameters)
   {
     if (xSemaphoreTake(xSemaphore3, portMAX_DELAY))
     {
-      auto landedPixelStatesBegin = landedPixelStates.begin();
-      auto landedPixelStatesMid = std::next(landedPixelStatesBegin, (landedPixelStates.size() / 2));
-      auto landedPixelStatesEnd = landedPixelStates.end();
-
-      auto pixelStatesBegin = pixelStates.begin();
-      auto pixelStatesMid = std::next(pixelStatesBegin, (pixelStates.size() / 2));
-      auto pixelStatesEnd = pixelStates.end();
-
-      setNextColorAll(landedPixelStatesMid, landedPixelStatesEnd, pixelStatesMid, pixelStatesEnd);
+      setNextColorAll(SCALED_COLS / 2, SCALED_COLS);
 
       xSemaphoreGive(xSemaphore4); // release the mutex
     }
@@ -455,6 +318,9 @@ void task2(void *pvParameters)
 void setup()
 {
   // Serial.begin(115200);
+#ifdef SAND_PROFILE
+  Serial.begin(115200);
+#endif
 
   Serial.println("Init display...");
   display.init();
@@ -483,9 +349,7 @@ void setup()
 
   colorChangeTime = millis() + 1000;
 
-  // Set the tallest pixel column to be 1 slot bellow the "bottom" (0,0 coordinate being top left.)
-  for (int32_t xCol = 0; xCol < SCALED_COLS; xCol++)
-    landedPixelsColumnTops[xCol] = SCALED_ROWS;
+  sand.begin();
 
   auto viewportWidth = display.width();
   auto viewportHeight = display.height();
@@ -493,7 +357,6 @@ void setup()
   // Serial.printf("Viewport dimensions (W x H): %i x %i\n", viewportWidth, viewportHeight);
 
   xDisplayMutex = xSemaphoreCreateMutex();
-  xStateMutex = xSemaphoreCreateMutex();
   xSemaphore1 = xSemaphoreCreateCounting(1, 0);
   xSemaphore2 = xSemaphoreCreateCounting(1, 0);
   xSemaphore3 = xSemaphoreCreateCounting(1, 0);
@@ -543,19 +406,10 @@ void loop()
   display.setTextColor(TFT_WHITE, TFT_BLACK);
   display.drawString(fpsStringBuffer, 0, 0);
 
-  // uint32_t psramSize = ESP.getPsramSize();
-  // uint32_t freePsram = ESP.getFreePsram();
-  // sprintf(fpsStringBuffer, "psram: %6u / %6u", freePsram, psramSize);
-  // display.drawString(fpsStringBuffer, 0, 10);
-
-  // uint32_t heapSize = ESP.getHeapSize();
-  // uint32_t freeHeap = ESP.getFreeHeap();
-  // sprintf(fpsStringBuffer, "heap: %6u / %6u", freeHeap, heapSize);
-  // display.drawString(fpsStringBuffer, 0, 20);
-
-  // uint32_t minFreeHeap = ESP.getMinFreeHeap();
-  // sprintf(fpsStringBuffer, "min free heap: %6u", minFreeHeap);
-  // display.drawString(fpsStringBuffer, 0, 30);
+#ifdef SAND_PROFILE
+  // Display the averages from the last profile report.
+  display.drawString(SAND_PROFILE_OVERLAY(), 0, 10);
+#endif
 
   lastMillis = currentMillis;
 
@@ -564,19 +418,16 @@ void loop()
   {
     allColorChangeTime = millis() + millisToChangeAllColors;
 
-    auto landedPixelStatesBegin = landedPixelStates.begin();
-    auto landedPixelStatesMid = std::next(landedPixelStatesBegin, (landedPixelStates.size() / 2));
-
-    auto pixelStatesBegin = pixelStates.begin();
-    auto pixelStatesMid = std::next(pixelStatesBegin, (pixelStates.size() / 2));
-
     // Start task and proceed.
     xSemaphoreGive(xSemaphore3);
 
-    setNextColorAll(landedPixelStatesBegin, landedPixelStatesMid, pixelStatesBegin, pixelStatesMid);
+    setNextColorAll(0, SCALED_COLS / 2);
 
     // Wait for task to complete.
-    xSemaphoreTake(xSemaphore4, portMAX_DELAY);
+    {
+      SAND_PROFILE_SCOPE(SAND_TIMER_WAIT_PHASE);
+      xSemaphoreTake(xSemaphore4, portMAX_DELAY);
+    }
 
     setNextColor(newRgbValues, newKValue);
   }
@@ -604,26 +455,17 @@ void loop()
 
   if (withinNativeCols(inputX) && withinNativeRows(inputY))
   {
+    SAND_PROFILE_SCOPE(SAND_TIMER_SPAWN);
+
     // Randomly add an area of pixels
     int32_t halfInputWidth = inputWidth / 2;
     for (int32_t i = -halfInputWidth; i <= halfInputWidth; ++i)
     {
       for (int32_t j = -halfInputWidth; j <= halfInputWidth; ++j)
       {
-        if (random(100) < percentInputFill)
+        if (sandRandom.nextBelow(100) < percentInputFill)
         {
-          uint32_t xCol = inputX + i;
-          uint32_t yRow = inputY + j;
-
-          // Concat the 16 bit x/y values into a single 32 bit value for more efficient storage.
-          uint64_t xy = ((uint64_t)xCol << 16) | (uint64_t)yRow;
-
-          if (withinNativeCols(xCol) && withinNativeRows(yRow) && pixelStates.find(xy) == pixelStates.end())
-          {
-            pixelStates[xy] = PointState(xCol, yRow, GRID_STATE_NEW, newKValue, 1, getPixelShape());
-            setColor(pixelStates[xy].RgbValues, newRgbValues[0], newRgbValues[1], newRgbValues[2]);
-            drawScaledPixel(xCol, yRow, pixelStates[xy].RgbValues, pixelStates[xy].Shape);
-          }
+          sand.spawn(inputX + i, inputY + j, packRgb(newRgbValues), packAux(getPixelShape(), newKValue));
         }
       }
     }
@@ -631,31 +473,26 @@ void loop()
 
   // Split up the work.
 
-  auto pixelStatesBegin = pixelStates.begin();
-  auto pixelStatesMid = std::next(pixelStatesBegin, (pixelStates.size() / 2));
-
-  pixelStatesToAdd.clear();
-  pixelsToErase.clear();
-
-  // Start task and proceed.
-  xSemaphoreGive(xSemaphore1);
+  sand.beginFrame();
 
-  movePixels(pixelStatesBegin, pixelStatesMid);
+  // Both cores move the pixels in their own column stripes, in two phases so neighbouring
+  // stripes are never updated at the same time. No locks are needed, but both cores have to
+  // finish a phase before either starts the next one.
+  for (uint8_t phase = 0; phase < 2; phase++)
+  {
+    movePhase = phase;
 
-  // Wait for task to complete.
-  xSemaphoreTake(xSemaphore2, portMAX_DELAY);
+    // Start task and proceed.
+    xSemaphoreGive(xSemaphore1);
 
-  for (const auto &key : pixelsToErase)
-  {
-    if (pixelStatesToAdd.find(key) != pixelStatesToAdd.end())
-      continue; // Do not erase pixel if it is being back-filled.
+    sand.moveStripes(phase, 0, 2, sandRandom);
 
-    pixelStates.erase(key);
+    // Wait for task to complete.
+    {
+      SAND_PROFILE_SCOPE(SAND_TIMER_WAIT_PHASE);
+      xSemaphoreTake(xSemaphore2, portMAX_DELAY);
+    }
   }
 
-  for (const auto &keyVal : pixelStatesToAdd)
-  {
-    pixelStates[keyVal.first] = PointState(keyVal.second.XCol, keyVal.second.YRow, keyVal.second.State, keyVal.second.ColorState, keyVal.second.Velocity, keyVal.second.Shape);
-    setColor(pixelStates[keyVal.first].RgbValues, keyVal.second.RgbValues[0], keyVal.second.RgbValues[1], keyVal.second.RgbValues[2]);
-  }
+  SAND_PROFILE_REPORT(1000);
 }
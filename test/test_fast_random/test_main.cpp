@@ -0,0 +1,88 @@
+// Checks for the FastRandom generator used by the sand and particle projects.
+//
+// Run with: pio test -e native -f test_fast_random -v
+
+#include <unity.h>
+#include "FastRandom.h"
+
+void test_same_seed_same_sequence()
+{
+  FastRandom a(42);
+  FastRandom b(42);
+
+  for (int i = 0; i < 1000; i++)
+    TEST_ASSERT_EQUAL_UINT32(a.next(), b.next());
+
+  // Reseeding starts the sequence over, including the buffered bits.
+  a.setSeed(7);
+  b.setSeed(7);
+  a.nextBit();
+  a.setSeed(7);
+  for (int i = 0; i < 100; i++)
+    TEST_ASSERT_EQUAL(a.nextBit(), b.nextBit());
+}
+
+void test_zero_seed()
+{
+  FastRandom random(0);
+
+  for (int i = 0; i < 100; i++)
+    TEST_ASSERT_NOT_EQUAL(0, random.next());
+}
+
+void test_next_below_in_range()
+{
+  FastRandom random(12345);
+  uint32_t counts[10] = {};
+
+  for (int i = 0; i < 100000; i++)
+  {
+    uint32_t value = random.nextBelow(10);
+    TEST_ASSERT_LESS_THAN_UINT32(10, value);
+    counts[value]++;
+  }
+
+  // Every value shows up about as often as the others.
+  for (int i = 0; i < 10; i++)
+    TEST_ASSERT_UINT32_WITHIN(1000, 10000, counts[i]);
+}
+
+void test_next_range_like_arduino()
+{
+  FastRandom random(12345);
+
+  for (int i = 0; i < 10000; i++)
+  {
+    int32_t value = random.nextRange(-5, 5);
+    TEST_ASSERT_TRUE(value >= -5 && value < 5);
+  }
+
+  // An empty range returns its start, as Arduino's random(howSmall, howBig) does.
+  TEST_ASSERT_EQUAL_INT32(3, random.nextRange(3, 3));
+}
+
+void test_bits_balanced()
+{
+  FastRandom random(12345);
+  uint32_t ones = 0;
+
+  for (int i = 0; i < 100000; i++)
+    ones += random.nextBit();
+
+  TEST_ASSERT_UINT32_WITHIN(1000, 50000, ones);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_same_seed_same_sequence);
+  RUN_TEST(test_zero_seed);
+  RUN_TEST(test_next_below_in_range);
+  RUN_TEST(test_next_range_like_arduino);
+  RUN_TEST(test_bits_balanced);
+  return UNITY_END();
+}
@@ -0,0 +1,407 @@
+// Checks the fluid field types: that swapping and moving fields exchanges their memory instead of
+// copying it, that the operations on a VectorField give the same results as on a Field of Vectors
+// and on fixed-size fields as on ones sized at runtime, that fields are placed in an Arena when one
+// is given, that the fused projection passes match the separate ones, and that advecting with a shared
+// Backtrace matches semilagrangian_advect (printing how long each takes on this machine).
+//
+// Run with: pio test -e native -f test_fluid_field -v
+
+#include <unity.h>
+#include <stdio.h>
+#include <math.h>
+#include <utility>
+#include <chrono>
+#include "Field.h"
+#include "VectorField.h"
+#include "DoubleBuffer.h"
+#include "Backtrace.h"
+#include "operations.h"
+#include "Multigrid.h"
+#include "Arena.h"
+
+static const int N_ROWS = 60;
+static const int N_COLS = 80;
+static const float DT = 1 / 12.0;
+static const int REPEATS = 100;
+
+static void fill(Field<float> *field, float value)
+{
+  for (int i = 0; i < field->N_i; i++)
+    for (int j = 0; j < field->N_j; j++)
+      field->index(i, j) = value;
+  field->update_boundary();
+}
+
+void test_swap_exchanges_memory()
+{
+  Field<float> a(3, 4, CLONE), b(5, 6, NEGATIVE);
+  fill(&a, 1);
+  fill(&b, 2);
+  const float *a_cell = &a.index(0, 0), *b_cell = &b.index(0, 0);
+
+  a.swap(b);
+
+  TEST_ASSERT_TRUE(&a.index(0, 0) == b_cell);
+  TEST_ASSERT_TRUE(&b.index(0, 0) == a_cell);
+  TEST_ASSERT_EQUAL_INT(5, a.N_i);
+  TEST_ASSERT_EQUAL_INT(6, a.N_j);
+  TEST_ASSERT_EQUAL_INT(NEGATIVE, a.bc);
+  TEST_ASSERT_EQUAL_FLOAT(2, a.index(4, 5));
+  TEST_ASSERT_EQUAL_FLOAT(1, b.index(2, 3));
+}
+
+void test_move_takes_memory()
+{
+  Field<float> a(3, 4, CLONE);
+  fill(&a, 1);
+  const float *a_cell = &a.index(0, 0);
+
+  Field<float> b(std::move(a));
+  TEST_ASSERT_TRUE(&b.index(0, 0) == a_cell);
+  TEST_ASSERT_EQUAL_INT(0, a.N_i);
+
+  Field<float> c(2, 2, CLONE);
+  c = std::move(b);
+  TEST_ASSERT_TRUE(&c.index(0, 0) == a_cell);
+  TEST_ASSERT_EQUAL_INT(3, c.N_i);
+  TEST_ASSERT_EQUAL_FLOAT(1, c.index(2, 3));
+}
+
+void test_double_buffer_swap()
+{
+  DoubleBuffer<Field<float>> buffer(3, 4, CLONE);
+  Field<float> *front = buffer.front(), *back = buffer.back();
+  fill(front, 1);
+  fill(back, 2);
+  const float *back_cell = &back->index(0, 0);
+
+  buffer.swap();
+
+  // The fields stay where they are, and only their memory moves.
+  TEST_ASSERT_TRUE(buffer.front() == front);
+  TEST_ASSERT_TRUE(buffer.back() == back);
+  TEST_ASSERT_TRUE(&front->index(0, 0) == back_cell);
+  TEST_ASSERT_EQUAL_FLOAT(2, front->index(1, 1));
+  TEST_ASSERT_EQUAL_FLOAT(1, back->index(1, 1));
+}
+
+static double microsecondsSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs the velocity steps of sim_routine (advection, then the projection) on either layout, and
+// returns how long they took, in us per frame.
+template <class VELOCITY_T, class SCALAR_FIELD_T>
+static double stepVelocity(DoubleBuffer<VELOCITY_T> *velocity, SCALAR_FIELD_T *divergence_field, SCALAR_FIELD_T *pressure_field)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int k = 0; k < REPEATS; k++)
+  {
+    semilagrangian_advect(velocity->back(), velocity->front(), velocity->front(), DT);
+    velocity->swap();
+    divergence(divergence_field, velocity->front());
+    sor_pressure(pressure_field, divergence_field, 10, 1.3);
+    gradient_and_subtract(velocity->front(), pressure_field);
+  }
+  return microsecondsSince(start) / REPEATS;
+}
+
+void test_vector_field_matches_field_of_vectors()
+{
+  DoubleBuffer<Field<Vector<float>>> interleaved(N_ROWS, N_COLS, NEGATIVE);
+  DoubleBuffer<VectorField<float>> planar(N_ROWS, N_COLS, NEGATIVE);
+  const int center_i = N_ROWS / 2, center_j = N_COLS / 2;
+  for (int i = 0; i < N_ROWS; i++)
+  {
+    for (int j = 0; j < N_COLS; j++)
+    {
+      Vector<float> v = {(float)(center_j - j), (float)(i - center_i)};
+      if (i > 10 && i < 14 && j > 10 && j < 30)
+        v = {0, 120};
+      interleaved.front()->index(i, j) = v;
+      planar.front()->set(i, j, v);
+    }
+  }
+  interleaved.front()->update_boundary();
+  planar.front()->update_boundary();
+
+  Field<float> divergence_field(N_ROWS, N_COLS, DONTCARE), pressure_field(N_ROWS, N_COLS, CLONE);
+  double interleaved_us = stepVelocity(&interleaved, &divergence_field, &pressure_field);
+  double planar_us = stepVelocity(&planar, &divergence_field, &pressure_field);
+  printf("velocity steps: Field<Vector> %.0f us/frame, VectorField %.0f us/frame\n", interleaved_us, planar_us);
+
+  for (int i = -1; i <= N_ROWS; i++)
+  {
+    for (int j = -1; j <= N_COLS; j++)
+    {
+      TEST_ASSERT_EQUAL_FLOAT(interleaved.front()->index(i, j).x, planar.front()->x.index(i, j));
+      TEST_ASSERT_EQUAL_FLOAT(interleaved.front()->index(i, j).y, planar.front()->y.index(i, j));
+    }
+  }
+
+  // Colors advected by either velocity come out the same too.
+  Field<float> color(N_ROWS, N_COLS, CLONE), by_interleaved(N_ROWS, N_COLS, CLONE), by_planar(N_ROWS, N_COLS, CLONE);
+  for (int i = 0; i < N_ROWS; i++)
+    for (int j = 0; j < N_COLS; j++)
+      color.index(i, j) = (i / 6 + j / 8) % 2;
+  color.update_boundary();
+  semilagrangian_advect(&by_interleaved, &color, interleaved.front(), DT);
+  semilagrangian_advect(&by_planar, &color, planar.front(), DT);
+  for (int i = 0; i < N_ROWS; i++)
+    for (int j = 0; j < N_COLS; j++)
+      TEST_ASSERT_EQUAL_FLOAT(by_interleaved.index(i, j), by_planar.index(i, j));
+}
+
+// The swirl and drag the fluid-simulation project starts from
+template <class VELOCITY_T>
+static void initSwirl(VELOCITY_T *velocity)
+{
+  const int center_i = N_ROWS / 2, center_j = N_COLS / 2;
+  for (int i = 0; i < N_ROWS; i++)
+  {
+    for (int j = 0; j < N_COLS; j++)
+    {
+      Vector<float> v = {(float)(center_j - j), (float)(i - center_i)};
+      if (i > 10 && i < 14 && j > 10 && j < 30)
+        v = {0, 120};
+      velocity->set(i, j, v);
+    }
+  }
+  velocity->update_boundary();
+}
+
+void test_fixed_size_field_matches_dynamic()
+{
+  typedef Field<float, N_ROWS, N_COLS> FixedField;
+  typedef VectorField<float, N_ROWS, N_COLS> FixedVectorField;
+
+  // The shape is part of the type, and the memory can be given to the field.
+  static float pressure_storage[FixedField::STORAGE_ELEMS];
+  FixedField fixed_divergence(DONTCARE), fixed_pressure(pressure_storage, CLONE);
+  TEST_ASSERT_EQUAL_INT(N_ROWS, fixed_pressure.N_i);
+  TEST_ASSERT_EQUAL_INT(N_COLS, fixed_pressure.N_j);
+  TEST_ASSERT_TRUE(fixed_pressure.data() == pressure_storage);
+  TEST_ASSERT_EQUAL_INT(Field<float>(N_ROWS, N_COLS, CLONE).offset(N_ROWS, N_COLS) + 1, FixedField::STORAGE_ELEMS);
+
+  DoubleBuffer<VectorField<float>> dynamic(N_ROWS, N_COLS, NEGATIVE);
+  DoubleBuffer<FixedVectorField> fixed(NEGATIVE);
+  initSwirl(dynamic.front());
+  initSwirl(fixed.front());
+
+  Field<float> dynamic_divergence(N_ROWS, N_COLS, DONTCARE), dynamic_pressure(N_ROWS, N_COLS, CLONE);
+  double dynamic_us = stepVelocity(&dynamic, &dynamic_divergence, &dynamic_pressure);
+  double fixed_us = stepVelocity(&fixed, &fixed_divergence, &fixed_pressure);
+  printf("velocity steps: VectorField<float> %.0f us/frame, VectorField<float, %d, %d> %.0f us/frame\n",
+         dynamic_us, N_ROWS, N_COLS, fixed_us);
+
+  for (int i = -1; i <= N_ROWS; i++)
+  {
+    for (int j = -1; j <= N_COLS; j++)
+    {
+      TEST_ASSERT_EQUAL_FLOAT(dynamic.front()->x.index(i, j), fixed.front()->x.index(i, j));
+      TEST_ASSERT_EQUAL_FLOAT(dynamic.front()->y.index(i, j), fixed.front()->y.index(i, j));
+      TEST_ASSERT_EQUAL_FLOAT(dynamic_pressure.index(i, j), fixed_pressure.index(i, j));
+    }
+  }
+}
+
+// The worst divergence over the domain, found the way sim_routine did before the fused passes
+template <class SCALAR_FIELD_T, class VELOCITY_T>
+static float maxDivergence(SCALAR_FIELD_T *divergence_field, const VELOCITY_T *velocity)
+{
+  divergence(divergence_field, velocity);
+  float worst = 0;
+  for (int i = 0; i < N_ROWS; i++)
+    for (int j = 0; j < N_COLS; j++)
+      if (fabsf(divergence_field->index(i, j)) > worst)
+        worst = fabsf(divergence_field->index(i, j));
+  return worst;
+}
+
+void test_fused_projection_matches_separate()
+{
+  typedef Field<float, N_ROWS, N_COLS> FixedField;
+  typedef VectorField<float, N_ROWS, N_COLS> FixedVectorField;
+  const float carry_over = 0.9;
+
+  FixedVectorField separate(NEGATIVE), fused(NEGATIVE);
+  FixedField separate_divergence(DONTCARE), fused_divergence(DONTCARE);
+  FixedField separate_pressure(CLONE), fused_pressure(CLONE);
+  initSwirl(&separate);
+  initSwirl(&fused);
+
+  // Start both from the same last frame's pressure, so the carry over has something to scale
+  divergence(&separate_divergence, &separate);
+  sor_pressure(&separate_pressure, &separate_divergence, 10, 1.3);
+  fused_pressure = separate_pressure;
+
+  float separate_before = maxDivergence(&separate_divergence, &separate);
+  carry_over_pressure(&separate_pressure, carry_over);
+  sor_iterate(&separate_pressure, &separate_divergence, 10, 1.3);
+  gradient_and_subtract(&separate, &separate_pressure);
+  float separate_after = maxDivergence(&separate_divergence, &separate);
+
+  float fused_before = divergence_and_carry_over(&fused_divergence, &fused, &fused_pressure, carry_over);
+  sor_iterate(&fused_pressure, &fused_divergence, 10, 1.3);
+  float fused_after = gradient_and_subtract_max_divergence(&fused, &fused_pressure);
+
+  TEST_ASSERT_EQUAL_FLOAT(separate_before, fused_before);
+  TEST_ASSERT_EQUAL_FLOAT(separate_after, fused_after);
+  TEST_ASSERT_TRUE(fused_after < fused_before);
+  for (int i = -1; i <= N_ROWS; i++)
+  {
+    for (int j = -1; j <= N_COLS; j++)
+    {
+      TEST_ASSERT_EQUAL_FLOAT(separate.x.index(i, j), fused.x.index(i, j));
+      TEST_ASSERT_EQUAL_FLOAT(separate.y.index(i, j), fused.y.index(i, j));
+      TEST_ASSERT_EQUAL_FLOAT(separate_pressure.index(i, j), fused_pressure.index(i, j));
+    }
+  }
+
+  // Everything in the projection but the SOR iterations, with the divergence tracked after it
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int k = 0; k < REPEATS; k++)
+  {
+    divergence(&separate_divergence, &separate);
+    carry_over_pressure(&separate_pressure, carry_over);
+    gradient_and_subtract(&separate, &separate_pressure);
+    separate_after += maxDivergence(&separate_divergence, &separate);
+  }
+  double separate_us = microsecondsSince(start) / REPEATS;
+  start = std::chrono::steady_clock::now();
+  for (int k = 0; k < REPEATS; k++)
+  {
+    divergence_and_carry_over(&fused_divergence, &fused, &fused_pressure, carry_over);
+    fused_after += gradient_and_subtract_max_divergence(&fused, &fused_pressure);
+  }
+  double fused_us = microsecondsSince(start) / REPEATS;
+  printf("projection passes: separate %.0f us/frame, fused %.0f us/frame\n", separate_us, fused_us);
+  TEST_ASSERT_EQUAL_FLOAT(separate_after, fused_after);
+}
+
+static bool inArena(const Arena &arena, const void *p)
+{
+  const char *base = static_cast<const char *>(arena.base());
+  return p >= base && p < base + arena.size();
+}
+
+void test_arena_places_fields()
+{
+  typedef Field<float, N_ROWS, N_COLS> FixedField;
+  const size_t field_bytes = Arena::bytes<float>(FixedField::STORAGE_ELEMS);
+
+  // Chained and sized exactly like setup() reserves the DRAM arenas with MULTIGRID, so everything
+  // should fit with nothing to spare.
+  Arena arena("front velocity", 2 * field_bytes);
+  Arena *back = new Arena("back velocity", 2 * field_bytes);
+  Arena *projection = new Arena("divergence and pressure", 2 * field_bytes);
+  Arena *rest = new Arena("rest", Backtrace::storage_bytes(N_ROWS, N_COLS) +
+                                      Multigrid<float>::storage_bytes(N_ROWS, N_COLS));
+  arena.chain(back);
+  arena.chain(projection);
+  arena.chain(rest);
+  TEST_ASSERT_TRUE(arena.reserved() && back->reserved() && projection->reserved() && rest->reserved());
+  TEST_ASSERT_TRUE(arena.next() == back);
+
+  DoubleBuffer<VectorField<float, N_ROWS, N_COLS>> velocity(NEGATIVE, &arena);
+  FixedField divergence_field(DONTCARE, &arena), pressure(CLONE, &arena);
+  Backtrace backtrace(N_ROWS, N_COLS, &arena);
+  Multigrid<float> multigrid(N_ROWS, N_COLS, &arena);
+  for (const Arena *link = &arena; link != NULL; link = link->next())
+  {
+    TEST_ASSERT_EQUAL_INT(0, (int)link->headroom());
+    TEST_ASSERT_EQUAL_INT(0, link->misses());
+  }
+  TEST_ASSERT_TRUE(inArena(arena, velocity.front()->y.data()));
+  TEST_ASSERT_TRUE(inArena(*back, velocity.back()->y.data()));
+  TEST_ASSERT_TRUE(inArena(*projection, pressure.data()));
+  TEST_ASSERT_EQUAL_FLOAT(0, pressure.index(N_ROWS - 1, N_COLS - 1)); // the elements are constructed
+
+  // Swapping still just exchanges the memory.
+  const float *back_cell = &velocity.back()->x.index(0, 0);
+  velocity.swap();
+  TEST_ASSERT_TRUE(&velocity.front()->x.index(0, 0) == back_cell);
+
+  // Once the chain is full, fields fall back on the heap, and the miss is counted on its last arena.
+  FixedField overflow(CLONE, &arena);
+  for (const Arena *link = &arena; link != NULL; link = link->next())
+    TEST_ASSERT_FALSE(inArena(*link, overflow.data()));
+  TEST_ASSERT_EQUAL_INT(0, arena.misses());
+  TEST_ASSERT_EQUAL_INT(1, rest->misses());
+  overflow.index(0, 0) = 1;
+
+  // And an arena that couldn't be reserved is just empty.
+  Arena empty("empty", 0);
+  TEST_ASSERT_FALSE(empty.reserved());
+  TEST_ASSERT_NULL(empty.allocate<float>(1));
+}
+
+// Advects a checkerboard by a swirl with semilagrangian_advect and with a Backtrace, three times
+// each like the colors, and returns the largest difference.
+template <class SCALAR_T, class DYE_T>
+static float compareBacktrace(const char *name)
+{
+  VectorField<SCALAR_T> velocity(N_ROWS, N_COLS, NEGATIVE);
+  Field<DYE_T> color(N_ROWS, N_COLS, CLONE), by_advect(N_ROWS, N_COLS, CLONE), by_backtrace(N_ROWS, N_COLS, CLONE);
+  const int center_i = N_ROWS / 2, center_j = N_COLS / 2;
+  for (int i = 0; i < N_ROWS; i++)
+  {
+    for (int j = 0; j < N_COLS; j++)
+    {
+      velocity.set(i, j, {SCALAR_T(0.7f * (center_j - j)), SCALAR_T(0.7f * (i - center_i))});
+      color.index(i, j) = (i / 6 + j / 8) % 2;
+    }
+  }
+  velocity.update_boundary();
+  color.update_boundary();
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int k = 0; k < REPEATS; k++)
+    for (int channel = 0; channel < 3; channel++)
+      semilagrangian_advect(&by_advect, &color, &velocity, DT);
+  double advect_us = microsecondsSince(start) / REPEATS;
+
+  Backtrace backtrace(N_ROWS, N_COLS);
+  start = std::chrono::steady_clock::now();
+  for (int k = 0; k < REPEATS; k++)
+  {
+    backtrace.trace(&velocity, DT);
+    for (int channel = 0; channel < 3; channel++)
+      backtrace.apply(&by_backtrace, &color);
+  }
+  double backtrace_us = microsecondsSince(start) / REPEATS;
+  printf("%s, three channels: semilagrangian_advect %.0f us, Backtrace %.0f us\n", name, advect_us, backtrace_us);
+
+  float worst = 0;
+  for (int i = -1; i <= N_ROWS; i++)
+    for (int j = -1; j <= N_COLS; j++)
+      worst = fmaxf(worst, fabsf((float)by_advect.index(i, j) - (float)by_backtrace.index(i, j)));
+  return worst;
+}
+
+void test_backtrace_matches_advect()
+{
+  // Q8.8 colors only get 8 bits of weight either way.
+  TEST_ASSERT_EQUAL_FLOAT(0, (compareBacktrace<q16_16_t, q8_8_t>("Q16.16 velocity, Q8.8 colors")));
+  // Float weights get rounded down to 1/256ths, so the colors (0 to 1) move by less than two of those.
+  TEST_ASSERT_FLOAT_WITHIN(2 / 256.0f, 0, (compareBacktrace<float, float>("float velocity, float colors")));
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_swap_exchanges_memory);
+  RUN_TEST(test_move_takes_memory);
+  RUN_TEST(test_double_buffer_swap);
+  RUN_TEST(test_vector_field_matches_field_of_vectors);
+  RUN_TEST(test_fixed_size_field_matches_dynamic);
+  RUN_TEST(test_fused_projection_matches_separate);
+  RUN_TEST(test_arena_places_fields);
+  RUN_TEST(test_backtrace_matches_advect);
+  return UNITY_END();
+}
@@ -0,0 +1,211 @@
+// Compares the fixed-point fluid kernels against the float ones, starting both from the same swirl
+// and color wheel that the fluid-simulation project starts from, and the same for 8-bit colors.
+//
+// Run with: pio test -e native -f test_fluid_fixed -v
+
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include "Fixed.h"
+#include "unorm8.h"
+#include "Vector.h"
+#include "Field.h"
+#include "VectorField.h"
+#include "DoubleBuffer.h"
+#include "Backtrace.h"
+#include "operations.h"
+
+static const int N_ROWS = 60;
+static const int N_COLS = 80;
+static const float DT = 1 / 12.0;
+static const float SOR_OMEGA = 1.3; // as in sim_routine
+static const int FRAMES = 60;
+
+template <class SCALAR_T, class DYE_T>
+struct FluidState
+{
+  DoubleBuffer<VectorField<SCALAR_T>> velocityBuffer;
+  VectorField<SCALAR_T> &velocity;
+  Field<SCALAR_T> divergenceField, pressureField;
+  Field<DYE_T> red, green, blue, colorScratch;
+  Backtrace colorBacktrace;
+
+  FluidState()
+      : velocityBuffer(N_ROWS, N_COLS, NEGATIVE), velocity(*velocityBuffer.front()),
+        divergenceField(N_ROWS, N_COLS, DONTCARE), pressureField(N_ROWS, N_COLS, CLONE),
+        red(N_ROWS, N_COLS, CLONE), green(N_ROWS, N_COLS, CLONE), blue(N_ROWS, N_COLS, CLONE),
+        colorScratch(N_ROWS, N_COLS, CLONE), colorBacktrace(N_ROWS, N_COLS) {}
+
+  // A swirl around the center, a drag like the touch routine makes, and the three color sectors.
+  void init()
+  {
+    const int center_i = N_ROWS / 2, center_j = N_COLS / 2;
+    for (int i = 0; i < N_ROWS; i++)
+    {
+      for (int j = 0; j < N_COLS; j++)
+      {
+        float x = i - center_i, y = j - center_j;
+        velocity.set(i, j, {-y, x});
+        if (i > 10 && i < 14 && j > 10 && j < 30)
+          velocity.set(i, j, {0, 120});
+
+        float angle = atan2(-x, y);
+        red.index(i, j) = (angle < -M_PI / 3) ? 1 : 0;
+        green.index(i, j) = (angle >= -M_PI / 3 && angle < M_PI / 3) ? 1 : 0;
+        blue.index(i, j) = (angle >= M_PI / 3) ? 1 : 0;
+      }
+    }
+    velocity.update_boundary();
+    red.update_boundary();
+    green.update_boundary();
+    blue.update_boundary();
+  }
+
+  // The same steps as sim_routine.
+  void step()
+  {
+    semilagrangian_advect(velocityBuffer.back(), &velocity, &velocity, DT);
+    velocityBuffer.swap();
+
+    divergence(&divergenceField, &velocity);
+    sor_pressure(&pressureField, &divergenceField, 10, SOR_OMEGA);
+    gradient_and_subtract(&velocity, &pressureField);
+
+    colorBacktrace.trace(&velocity, DT);
+    colorBacktrace.apply(&colorScratch, &red);
+    red.swap(colorScratch);
+    colorBacktrace.apply(&colorScratch, &green);
+    green.swap(colorScratch);
+    colorBacktrace.apply(&colorScratch, &blue);
+    blue.swap(colorScratch);
+  }
+};
+
+typedef FluidState<float, float> FloatState;
+typedef FluidState<q16_16_t, q8_8_t> FixedState;
+typedef FluidState<float, unorm8_t> Dye8State;
+
+template <class A, class B>
+static float maxDifference(const Field<A> &a, const Field<B> &b)
+{
+  float worst = 0;
+  for (int i = 0; i < N_ROWS; i++)
+    for (int j = 0; j < N_COLS; j++)
+      worst = fmaxf(worst, fabsf((float)a.index(i, j) - (float)b.index(i, j)));
+  return worst;
+}
+
+template <class A, class B>
+static float maxDifference(const VectorField<A> &a, const VectorField<B> &b)
+{
+  return fmaxf(maxDifference(a.x, b.x), maxDifference(a.y, b.y));
+}
+
+void test_fixed_arithmetic()
+{
+  TEST_ASSERT_EQUAL_INT32(0x18000, q16_16_t(1.5f).raw);
+  TEST_ASSERT_EQUAL_INT32(-0x18000, q16_16_t(-1.5f).raw);
+  TEST_ASSERT_EQUAL_INT(-2, q16_16_t(-1.5f).floor());
+  TEST_ASSERT_EQUAL_INT(1, q16_16_t(1.5f).floor());
+
+  TEST_ASSERT_EQUAL_FLOAT(-2.25f, (float)(q16_16_t(1.5f) * q16_16_t(-1.5f)));
+  TEST_ASSERT_EQUAL_FLOAT(-0.375f, (float)(q16_16_t(1.5f) / (-4)));
+  TEST_ASSERT_EQUAL_FLOAT(3.0f, (float)(2 * q16_16_t(1.5f)));
+
+  // Converting between formats keeps the value.
+  TEST_ASSERT_EQUAL_FLOAT(0.75f, (float)q8_8_t(q16_16_t(0.75f)));
+  TEST_ASSERT_EQUAL_FLOAT(0.75f, (float)q16_16_t(q8_8_t(0.75f)));
+}
+
+void test_interpolation_weights_sum_to_one()
+{
+  // (1-d)+d is exactly one in fixed point, so interpolating a constant gives it back.
+  for (int k = 0; k <= 256; k++)
+  {
+    q8_8_t d = q8_8_t::from_raw(k);
+    q8_8_t value = 0.5f;
+    TEST_ASSERT_EQUAL_INT16(value.raw, billinear_interpolate(d, d, value, value, value, value).raw);
+  }
+}
+
+void test_matches_float_path()
+{
+  static FloatState floatState;
+  static FixedState fixedState;
+  floatState.init();
+  fixedState.init();
+
+  for (int frame = 0; frame < FRAMES; frame++)
+  {
+    floatState.step();
+    fixedState.step();
+  }
+
+  float velocityError = maxDifference(floatState.velocity, fixedState.velocity);
+  float colorError = fmaxf(maxDifference(floatState.red, fixedState.red),
+                           fmaxf(maxDifference(floatState.green, fixedState.green),
+                                 maxDifference(floatState.blue, fixedState.blue)));
+  printf("after %d frames: max velocity error %.4f cells/s, max color error %.4f\n", FRAMES, velocityError, colorError);
+
+  // The velocities reach 120 cells/s, and the colors go from 0 to 1 in steps of 1/256.
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 0, velocityError);
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 0, colorError);
+}
+
+void test_unorm8_interpolation()
+{
+  TEST_ASSERT_EQUAL_INT(255, unorm8_t(1).raw);
+  TEST_ASSERT_EQUAL_INT(128, unorm8_t(0.5f).raw);
+  TEST_ASSERT_EQUAL_INT(0, unorm8_t(-0.5f).raw);
+  TEST_ASSERT_EQUAL_INT(255, unorm8_t(1.5f).raw);
+
+  // Constants come back exactly, and the rest is within rounding of the float interpolation.
+  for (int k = 0; k <= 256; k++)
+  {
+    q8_8_t d = q8_8_t::from_raw(k);
+    unorm8_t value = unorm8_t::from_raw(200);
+    TEST_ASSERT_EQUAL_INT(200, billinear_interpolate(d, q8_8_t::from_raw(256 - k), value, value, value, value).raw);
+
+    unorm8_t p11 = unorm8_t::from_raw(0), p12 = unorm8_t::from_raw(255), p21 = unorm8_t::from_raw(30), p22 = unorm8_t::from_raw(99);
+    float expected = billinear_interpolate((float)d, 0.25f, (float)p11, (float)p12, (float)p21, (float)p22);
+    float interpolated = (float)billinear_interpolate(d, q8_8_t(0.25f), p11, p12, p21, p22);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f / 255, expected, interpolated);
+  }
+}
+
+void test_dye8_matches_float_path()
+{
+  static FloatState floatState;
+  static Dye8State dye8State;
+  floatState.init();
+  dye8State.init();
+
+  for (int frame = 0; frame < FRAMES; frame++)
+  {
+    floatState.step();
+    dye8State.step();
+  }
+
+  float colorError = fmaxf(maxDifference(floatState.red, dye8State.red),
+                           fmaxf(maxDifference(floatState.green, dye8State.green),
+                                 maxDifference(floatState.blue, dye8State.blue)));
+  printf("after %d frames: max 8-bit color error %.4f\n", FRAMES, colorError);
+
+  // The velocity is the same float one, so the difference is only from rounding the colors to 1/255.
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 0, colorError);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_fixed_arithmetic);
+  RUN_TEST(test_interpolation_weights_sum_to_one);
+  RUN_TEST(test_matches_float_path);
+  RUN_TEST(test_unorm8_interpolation);
+  RUN_TEST(test_dye8_matches_float_path);
+  return UNITY_END();
+}
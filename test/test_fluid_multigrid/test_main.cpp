@@ -0,0 +1,170 @@
+// Checks the multigrid pressure solver against sor_pressure on the divergence of a swirl and a drag,
+// and prints how long each takes on this machine. Also checks that sor_pressure_until stops once the
+// pressure has converged, and that starting it from the last frame's pressure leaves less residual.
+//
+// Run with: pio test -e native -f test_fluid_multigrid -v
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "Fixed.h"
+#include "Vector.h"
+#include "Field.h"
+#include "VectorField.h"
+#include "DoubleBuffer.h"
+#include "operations.h"
+#include "Multigrid.h"
+
+static const int N_ROWS = 60;
+static const int N_COLS = 80;
+static const float SOR_OMEGA = 1.3; // as in sim_routine
+static const int CYCLES = 4;
+static const int REPEATS = 50;
+static const float DT = 1 / 12.0;
+static const int FRAMES = 30;
+
+template <class SCALAR_T>
+static void makeDivergence(Field<SCALAR_T> *divergence_field)
+{
+  Field<Vector<SCALAR_T>> velocity(N_ROWS, N_COLS, NEGATIVE);
+  const int center_i = N_ROWS / 2, center_j = N_COLS / 2;
+  for (int i = 0; i < N_ROWS; i++)
+  {
+    for (int j = 0; j < N_COLS; j++)
+    {
+      velocity.index(i, j) = {SCALAR_T(center_j - j), SCALAR_T(i - center_i)};
+      if (i > 10 && i < 14 && j > 10 && j < 30)
+        velocity.index(i, j) = {0, 120};
+    }
+  }
+  velocity.update_boundary();
+  divergence(divergence_field, &velocity);
+}
+
+static double microsecondsSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <class SCALAR_T>
+static void compareSolvers(const char *name)
+{
+  Field<SCALAR_T> divergence_field(N_ROWS, N_COLS, DONTCARE), pressure(N_ROWS, N_COLS, CLONE);
+  makeDivergence(&divergence_field);
+  sor_pressure(&pressure, &divergence_field, 0, SOR_OMEGA); // just zeroes it
+  float start_residual = pressure_residual(&pressure, &divergence_field);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int k = 0; k < REPEATS; k++)
+    sor_pressure(&pressure, &divergence_field, 10, SOR_OMEGA);
+  double sor_us = microsecondsSince(start) / REPEATS;
+  float sor_residual = pressure_residual(&pressure, &divergence_field);
+
+  Multigrid<SCALAR_T> multigrid(N_ROWS, N_COLS);
+  TEST_ASSERT_EQUAL_INT(3, multigrid.levels());
+
+  start = std::chrono::steady_clock::now();
+  for (int k = 0; k < REPEATS; k++)
+    multigrid.solve(&pressure, &divergence_field, 1);
+  double cycle_us = microsecondsSince(start) / REPEATS;
+
+  float residuals[CYCLES];
+  multigrid.solve(&pressure, &divergence_field, CYCLES, residuals);
+
+  printf("%s: SOR x10 %.0f us, residual %.3f | multigrid %.0f us/cycle, residuals", name, sor_us, sor_residual, cycle_us);
+  for (int cycle = 0; cycle < CYCLES; cycle++)
+    printf(" %.3f", residuals[cycle]);
+  printf(" (of %.3f to start)\n", start_residual);
+
+  // One cycle already beats the ten SOR iterations sim_routine runs, and each cycle improves on it.
+  TEST_ASSERT_LESS_THAN_FLOAT(sor_residual, residuals[0]);
+  for (int cycle = 1; cycle < CYCLES; cycle++)
+    TEST_ASSERT_LESS_THAN_FLOAT(residuals[cycle - 1], residuals[cycle]);
+}
+
+void test_multigrid_float()
+{
+  compareSolvers<float>("float");
+}
+
+void test_multigrid_fixed()
+{
+  compareSolvers<q16_16_t>("Q16.16");
+}
+
+void test_sor_stops_at_tolerance()
+{
+  Field<float> divergence_field(N_ROWS, N_COLS, DONTCARE), pressure(N_ROWS, N_COLS, CLONE);
+
+  // A still fluid needs no iterations at all.
+  sor_pressure(&divergence_field, &divergence_field, 0, SOR_OMEGA); // just zeroes it
+  TEST_ASSERT_EQUAL_INT(0, sor_pressure_until(&pressure, &divergence_field, 20, SOR_OMEGA, 0.5, 5));
+
+  // The swirl does, and stops in whole check periods once the residual is low enough.
+  makeDivergence(&divergence_field);
+  int iterations = sor_pressure_until(&pressure, &divergence_field, 200, SOR_OMEGA, 10, 5);
+  float residual = pressure_residual(&pressure, &divergence_field);
+  printf("SOR to a residual of 10: %d iterations, residual %.3f\n", iterations, residual);
+  TEST_ASSERT_LESS_THAN_FLOAT(10, residual);
+  TEST_ASSERT_EQUAL_INT(0, iterations % 5);
+  TEST_ASSERT_TRUE(iterations > 0 && iterations < 200);
+
+  // And never runs more than it's given.
+  TEST_ASSERT_EQUAL_INT(3, sor_pressure_until(&pressure, &divergence_field, 3, SOR_OMEGA, 0, 5));
+}
+
+// Runs the velocity steps of sim_routine from the swirl and drag, with ten SOR iterations per frame
+// that start from carry_over of the last frame's pressure, and returns the average residual they leave.
+static float averageResidual(float carry_over)
+{
+  DoubleBuffer<VectorField<float>> velocity(N_ROWS, N_COLS, NEGATIVE);
+  Field<float> divergence_field(N_ROWS, N_COLS, DONTCARE), pressure(N_ROWS, N_COLS, CLONE);
+  const int center_i = N_ROWS / 2, center_j = N_COLS / 2;
+  for (int i = 0; i < N_ROWS; i++)
+  {
+    for (int j = 0; j < N_COLS; j++)
+    {
+      velocity.front()->set(i, j, {(float)(center_j - j), (float)(i - center_i)});
+      if (i > 10 && i < 14 && j > 10 && j < 30)
+        velocity.front()->set(i, j, {0, 120});
+    }
+  }
+  velocity.front()->update_boundary();
+  carry_over_pressure(&pressure, 0);
+
+  float sum = 0;
+  for (int frame = 0; frame < FRAMES; frame++)
+  {
+    semilagrangian_advect(velocity.back(), velocity.front(), velocity.front(), DT);
+    velocity.swap();
+    divergence(&divergence_field, velocity.front());
+    float residual;
+    sor_pressure_until(&pressure, &divergence_field, 10, SOR_OMEGA, 0, 10, carry_over, &residual);
+    gradient_and_subtract(velocity.front(), &pressure);
+    sum += residual;
+  }
+  return sum / FRAMES;
+}
+
+void test_warm_start_lowers_residual()
+{
+  float cold = averageResidual(0), decayed = averageResidual(0.9), warm = averageResidual(1);
+  printf("average residual over %d frames of SOR x10, starting from: zero %.3f, 0.9x last pressure %.3f, last pressure %.3f\n",
+         FRAMES, cold, decayed, warm);
+  TEST_ASSERT_LESS_THAN_FLOAT(cold, decayed);
+  TEST_ASSERT_LESS_THAN_FLOAT(cold, warm);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_multigrid_float);
+  RUN_TEST(test_multigrid_fixed);
+  RUN_TEST(test_sor_stops_at_tolerance);
+  RUN_TEST(test_warm_start_lowers_residual);
+  return UNITY_END();
+}
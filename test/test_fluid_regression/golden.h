@@ -0,0 +1,168 @@
+// Golden snapshots for test_fluid_regression: the fields after GOLDEN_FRAMES frames, sampled every 
+// GOLDEN_STEP rows and columns, in the order velocity x, velocity y, pressure, red, green, blue.
+// Generated by building the test with -DFLUID_WRITE_GOLDEN (see test_main.cpp).
+
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#define GOLDEN_FRAMES 60
+#define GOLDEN_STEP 5
+#define GOLDEN_COLS 16 // 80/GOLDEN_STEP
+#define GOLDEN_SAMPLES 192 // (60/GOLDEN_STEP)*GOLDEN_COLS
+#define GOLDEN_FIELDS 6
+
+// float velocity and pressure, float colors
+static const float GOLDEN_FLOAT_SAMPLES[GOLDEN_FIELDS][GOLDEN_SAMPLES] = {
+    {0.0131073594, -0.0230306461, 0.0336407572, -0.0189343523, 0.0292707738, -0.00821972732, 0.0175281577, -0.00788695738, 0.00773182185, -0.00168099825, -0.00611612294, 0.00377752562, -0.0189935733, 0.0105738193, -0.017485965, 0.0130076595,
+     0.00996917859, 0.0213602316, 0.0428134687, 0.0795508698, 0.087671414, 0.0623341091, 0.0231904127, 0.00337244151, 0.00970660616, 0.000617044221, -0.0341968872, -0.0705840513, -0.0564385913, -0.0331358202, -0.0127181783, -0.00629246421,
+     -0.0019969556, 0.017996924, 0.0689104274, 0.171570942, 0.239009768, 0.129744828, 0.0188269988, -0.040404208, 0.0455563664, 0.0251777656, -0.0437487252, -0.196880996, -0.123929597, -0.0478404351, -0.0158826858, -0.00291505642,
+     -0.0357078463, -0.0203451701, 0.0399086587, 0.193048373, 0.13603878, -0.029944865, -0.0204095077, 0.322150409, 0.194494694, 0.200567797, 0.148551702, -0.560800731, -0.138176635, -0.0244308114, 0.000476987567, 0.00777494395,
+     -0.0815041512, -0.0978459343, -0.114369012, 1.09188485, -0.239272758, -0.16595231, -0.19870393, -0.164993957, 0.144900382, 0.246497288, -0.230495527, 0.47873494, 0.160357103, 0.0498869754, 0.029654162, 0.0226003341,
+     -0.149076104, -0.175217152, -0.25472033, 2.41348267, -0.143291458, -0.203725725, -0.173131615, -0.0768731683, 0.0185365472, 0.0513735414, 0.0192352198, 0.190246433, 0.146055982, 0.0800741464, 0.0468559079, 0.0358993262,
+     -0.168483242, -0.192508578, -0.213675216, 2.93737102, -0.557615757, -0.252959788, -0.159396082, -0.0753699169, -0.0145988204, 0.0274299961, 0.0568677709, 0.0935274884, 0.0948941931, 0.068742916, 0.0511224419, 0.0388821922,
+     -0.179733232, -0.191531003, -0.168062374, 0.894837856, -0.0170999207, -0.240037218, -0.136404753, -0.0739711523, -0.0216731988, 0.012875665, 0.0387023538, 0.0585860759, 0.0605820529, 0.0547960438, 0.0433166623, 0.0384842008,
+     -0.17004554, -0.193940073, -0.30231905, 0.489969403, 0.258139312, -0.167528957, -0.106934793, -0.055350773, -0.0212954003, 0.00611402141, 0.0257035363, 0.0366683044, 0.0423004329, 0.0387709327, 0.0361205116, 0.031235911,
+     -0.126349851, -0.150630131, -0.223030001, 0.458066106, -0.0818300247, -0.105870202, -0.0588870123, -0.0354490094, -0.0130295111, 0.00354461465, 0.0158469658, 0.0246552061, 0.0270715933, 0.0283086449, 0.0254683979, 0.0250071064,
+     -0.0696051568, -0.0601282082, -0.00844289735, 0.263170898, 0.190521643, 0.0206063967, -0.0137860943, -0.0129060755, -0.00585944811, 0.00290051452, 0.0101867467, 0.0144062489, 0.01748408, 0.0171655528, 0.0174623057, 0.0159841087,
+     -0.0242679678, -0.0130007565, 0.0191301424, 0.0928965509, 0.0787091479, 0.0320833176, 0.00223076972, -0.000469639199, -0.00215361523, 0.0033106592, 0.0039246548, 0.00813499466, 0.00719448179, 0.00945204776, 0.00749891531, 0.00897113793},
+    {0.0130819902, 0.0102284681, -0.00189139287, -0.0340902768, -0.0763458163, -0.136351839, -0.148932561, -0.153159171, -0.143841714, -0.135929123, -0.114958093, -0.0663169175, -0.0182432383, 0.010467357, 0.0190772433, 0.0104698129,
+     -0.0231500063, 0.0217754915, 0.0187077932, -0.0195205044, -0.0965818539, -0.158592701, -0.180348113, -0.157877982, -0.143132642, -0.152914703, -0.134151116, -0.0757587254, -0.00517917238, 0.0242169257, 0.0257081091, 0.0176815391,
+     0.0336668938, 0.042978365, 0.0689535961, 0.0449163839, -0.12895748, -0.167168826, -0.27729705, -0.113858938, -0.12389046, -0.189648628, -0.224222228, -0.0865097046, 0.04721554, 0.0605544224, 0.0437854566, 0.0179720111,
+     -0.0187325161, 0.0806233883, 0.169633657, 0.191858068, 0.968006074, 1.86857855, 2.15173483, 1.9434818, 0.703436971, 0.455744684, 0.415933669, 0.259837836, 0.220482111, 0.116798073, 0.0603518784, 0.0298810787,
+     0.02890517, 0.0934417695, 0.239052758, 0.218004167, -0.275621623, -0.15248844, -0.153665006, -0.227376834, 0.297653973, 0.566060126, 0.690868258, 0.357097924, 0.232695878, 0.118136346, 0.0631430149, 0.0241298806,
+     -0.00730532967, 0.0702689067, 0.192476794, 0.0300515704, -0.313063741, -0.200999454, -0.176932931, -0.208564609, -0.125918463, -0.0940646827, -0.103825897, -0.0656116381, 0.0598992482, 0.0679850131, 0.0447744727, 0.0239573326,
+     0.0163527951, 0.0264891759, -0.00633635279, 0.334538728, -0.271701574, -0.120223872, -0.108171217, -0.10343314, -0.0875341669, -0.0644372925, -0.0568672717, -0.0264564697, 0.016249571, 0.0321719795, 0.027957825, 0.0126072774,
+     -0.00468686316, 0.0151696391, 0.0445032828, 0.295487642, 0.0834208652, 0.0170617457, -0.0239165276, -0.0391257741, -0.0392251313, -0.035640575, -0.0255202316, -0.0111276172, 0.00707812235, 0.0167602785, 0.0157168657, 0.0107996864,
+     5.91744902e-05, -0.0145287542, 0.0486269481, 0.490247846, -0.309416711, 0.0748993531, 0.0401032753, 0.0113555938, -0.00348192593, -0.00815603323, -0.00709716557, -0.000990568777, 0.00610845024, 0.0100291036, 0.0100464914, 0.00464666821,
+     0.000300383952, -0.0733688548, -0.222566992, -0.69691819, 0.535484016, 0.177816197, 0.0853576064, 0.045004081, 0.021212915, 0.0106417211, 0.00588028366, 0.00593276694, 0.00708023505, 0.0081892712, 0.00684076408, 0.00521167833,
+     -0.0210276172, -0.0775487125, -0.181080759, -0.217598647, 0.216176897, 0.152466118, 0.0959098041, 0.0567003153, 0.0361262672, 0.0211576056, 0.014428976, 0.0101371184, 0.00890820101, 0.00729969004, 0.00592352403, 0.00252276007,
+     0.0109490734, -0.0571962483, -0.0857763588, -0.0513574518, 0.0580193624, 0.094108358, 0.0784792826, 0.0602469221, 0.0396024175, 0.0277256668, 0.0177991055, 0.0132272812, 0.00946436916, 0.00762999803, 0.00521622645, 0.00374242011},
+    {-0.0402131379, -0.0385151245, -0.0360345803, -0.0336549133, -0.0328387506, -0.0328894034, -0.0308546722, -0.0271617379, -0.0215174444, -0.0152854165, -0.00606901152, 0.00441245548, 0.0144268805, 0.0213901214, 0.0255505238, 0.0278981868,
+     -0.0383625664, -0.0364078879, -0.0340994783, -0.0301133245, -0.031540025, -0.0317900404, -0.0321393386, -0.0261107404, -0.0226163324, -0.0163538177, -0.00844861381, 0.00419915421, 0.0155533031, 0.0217922479, 0.0266132839, 0.0275066998,
+     -0.0354729146, -0.0335751027, -0.0264591202, -0.0223672278, -0.0243000612, -0.0336408503, -0.0359411389, -0.0242049415, -0.0216550678, -0.0233728997, -0.0156131536, 0.00319288066, 0.0188182592, 0.0254684351, 0.0265094023, 0.0290092994,
+     -0.0324886702, -0.0289039128, -0.0205568224, -0.00565953227, -0.00533150695, -0.0349313319, -0.0405566096, -0.0133289238, -0.0317674652, -0.0416488461, -0.0320885293, 0.000774730404, 0.0301759224, 0.027707614, 0.0289496332, 0.0278884023,
+     -0.0312246718, -0.0295335911, -0.0207950342, 0.00253067445, -0.0154194962, -0.0298506282, -0.0386993513, -0.0598650202, -0.00306015508, -0.0276308674, -0.0104098693, -0.00625286018, 0.0304125659, 0.0292411298, 0.0271227453, 0.0284734573,
+     -0.0310871359, -0.0304919221, -0.0346952192, -0.028389588, -0.0346960314, -0.0322841033, -0.0309635438, -0.0243945662, -0.0140323415, -0.00751700439, -0.00179848622, 0.00729080942, 0.0213103965, 0.0241476391, 0.0265724026, 0.0257541295,
+     -0.0283544194, -0.0307425428, -0.0332705118, -0.0375288241, -0.0673242658, -0.0346036926, -0.0216358677, -0.0150682423, -0.00728515768, -0.00147600577, 0.00440514041, 0.0116654951, 0.0176700242, 0.0225278139, 0.0231326222, 0.0250603296,
+     -0.0221995041, -0.0238262527, -0.0290805027, -0.00158378086, -0.044294171, -0.0214365609, -0.0127183497, -0.0055485731, -0.000119976663, 0.00466223201, 0.00956655666, 0.0134456102, 0.0181935709, 0.0199131258, 0.0225524493, 0.0221668854,
+     -0.0109905191, -0.0156932324, -0.0302693062, -0.0800400302, -0.0052224868, -0.0103626298, -0.00160258077, 0.00350384391, 0.00701053999, 0.0106080174, 0.0128496848, 0.0162360705, 0.0175897237, 0.0202164948, 0.0201666355, 0.021719886,
+     0.00421861466, 0.00218110206, -0.00721500535, -0.0460799336, -0.0322661027, 0.0040756138, 0.0105455667, 0.01222465, 0.0143620912, 0.0148635544, 0.0169049222, 0.0171526596, 0.0190989003, 0.0188396219, 0.0203452781, 0.0195620973,
+     0.0201206543, 0.0217806064, 0.0276429765, 0.0557928905, 0.0442429818, 0.0280775782, 0.0219161697, 0.0210892186, 0.0191376414, 0.019695051, 0.0185463056, 0.0195523612, 0.0186322797, 0.0197178461, 0.0187494867, 0.0197312254,
+     0.0303942636, 0.0318345353, 0.0397066362, 0.0467179567, 0.0467376448, 0.0356848314, 0.0305135325, 0.0251905434, 0.0238629282, 0.0211940631, 0.0211794712, 0.0194796529, 0.0199792385, 0.0186780971, 0.0194002893, 0.01832629},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 6.75117574e-41, 2.95673976e-43, 1.69977504e-42, 0, 0, 0, 0, 0,
+     3.14674051e-11, 4.00371153e-10, 2.65820077e-08, 9.0119287e-11, 2.0825027e-07, 1.00019886e-08, 3.065386e-10, 1.53763228e-16, 3.82449864e-24, 1.24146648e-30, 3.36183132e-39, 0, 0, 0, 0, 0,
+     0.00125613017, 0.00217055157, 0.0117810117, 6.64554773e-06, 0.0125441765, 0.00529250968, 0.000880009786, 4.57386977e-06, 3.21866195e-37, 3.78350585e-43, 0, 0, 0, 0, 0, 0,
+     1, 1, 0.997775555, 0.0390200168, 0.990328074, 0.996016383, 0.986379564, 0.968402028, 0.234658331, 1.43207862e-10, 0, 0, 0, 0, 0, 0,
+     1, 1, 1, 0.860205889, 0.971677184, 1, 1, 1, 0.99919188, 0.0011504034, 2.47876318e-13, 9.47307836e-21, 2.14438144e-28, 2.46907024e-38, 0, 0,
+     1, 1, 1, 0.998151362, 0.999407589, 1, 1, 1, 1, 0.588743687, 1.41146742e-07, 1.67630615e-14, 4.87718998e-23, 4.1003447e-33, 3.22298647e-44, 0,
+     1, 1, 0.999999702, 0.967820108, 0.99220264, 1, 1, 1, 1, 0.999923646, 0.0323258266, 1.01834168e-08, 3.46231136e-17, 6.31860984e-27, 1.24617562e-37, 0,
+     1, 1, 1, 0.99999541, 0.999999642, 1, 1, 1, 1, 1, 0.902466416, 0.000208846774, 5.99093301e-12, 4.55865011e-21, 2.80338805e-31, 2.13277626e-42,
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0.240431756, 2.92577681e-07, 1.24987843e-15, 2.49119365e-25, 4.78874796e-36},
+    {0, 0, 0, 0, 0, 0, 0, 0, 5.94044886e-34, 2.64771499e-20, 1.57151714e-09, 0.187182382, 0.999952137, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 1.16913367e-36, 5.42833293e-27, 1.06848922e-17, 1.79377246e-09, 0.00510796811, 0.994254827, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 6.47312683e-36, 9.29160973e-27, 1.50128876e-18, 2.21615171e-10, 0.000529598503, 0.803691745, 0.999994755, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 2.80259693e-45, 2.26618519e-29, 4.1961443e-14, 0.00445355661, 0.843068123, 0.899968266, 0.999983251, 1, 1, 1,
+     0, 0, 0, 0, 1.24419667e-33, 1.47486026e-25, 1.07964821e-17, 7.37127644e-13, 2.57843385e-05, 0.0393637046, 0.906168103, 0.877661705, 0.999961495, 1, 1, 1,
+     0, 0, 0, 0, 1.33404909e-29, 2.25727068e-21, 2.01967132e-13, 1.50762219e-06, 0.116767049, 0.995254457, 0.99998188, 0.999985337, 1, 1, 1, 1,
+     0, 0, 0, 0, 6.72681491e-33, 9.96495848e-23, 5.12261999e-13, 4.40278782e-05, 0.743575633, 1, 1, 1, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 2.22586884e-19, 0.00080822967, 0.998849571, 1, 1, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 7.56509326e-31, 1.95390717e-11, 0.411256284, 1, 1, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 2.21937651e-41, 2.41388896e-20, 7.648475e-05, 0.967674434, 1, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 5.50236492e-30, 2.70554412e-12, 0.0975334197, 0.999791145, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 1.37962038e-40, 2.5992212e-21, 1.19114702e-07, 0.759568334, 0.99999994, 1, 1, 1},
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0.812817514, 4.79538576e-05, 3.30900585e-12, 3.11362415e-21, 2.46625862e-31,
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0.994891882, 0.00574514968, 2.64025291e-09, 2.60501807e-17, 3.28057668e-26, 2.63391091e-36,
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 0.999470532, 0.196308151, 5.60720446e-06, 2.05967639e-11, 3.2732912e-19, 3.06393884e-28, 6.79295686e-39,
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 0.995546579, 0.156931877, 0.10003183, 1.68938059e-05, 1.55496449e-12, 1.01923969e-21, 3.6436387e-33,
+     1, 1, 1, 1, 0.99999994, 1, 1, 1, 0.999974191, 0.960636199, 0.0938318446, 0.122338369, 3.87045147e-05, 4.50012423e-12, 3.54118928e-21, 3.97547958e-32,
+     0.998743951, 0.997829437, 0.988218844, 0.999993384, 0.987455726, 0.994707525, 0.999119937, 0.99999404, 0.883232951, 0.00474560261, 1.81771466e-05, 1.46404345e-05, 2.25996777e-10, 6.95136117e-18, 3.66925092e-27, 1.10895846e-38,
+     0, 8.80613715e-09, 0.00222433871, 0.960979879, 0.00967198331, 0.00398353999, 0.0136205414, 0.0315538757, 0.0217660051, 6.6966237e-09, 1.31691325e-11, 2.25333988e-12, 6.58198863e-18, 6.11921376e-26, 2.33297976e-35, 0,
+     0, 1.63077794e-26, 1.39005145e-14, 0.139794216, 0.0283228662, 2.11294321e-07, 5.05518266e-11, 2.91606989e-10, 7.08132575e-09, 1.41234697e-16, 1.56651464e-20, 3.66453936e-21, 3.68952711e-27, 2.7641566e-35, 2.80259693e-45, 0,
+     0, 5.49880306e-19, 3.95481266e-08, 0.00184873701, 0.000592325232, 3.12260049e-08, 2.9594553e-16, 1.03166373e-19, 5.64756777e-18, 2.82508445e-25, 7.0849546e-31, 1.25254659e-31, 1.24871881e-37, 0, 0, 0,
+     0, 4.28248873e-17, 3.18434473e-07, 0.0321799293, 0.00779735949, 1.35723219e-08, 1.7507855e-17, 1.31121933e-28, 1.09594071e-27, 1.2283916e-32, 7.14942476e-42, 4.33001225e-43, 0, 0, 0, 0,
+     0, 1.30269374e-24, 1.61774931e-13, 4.71178646e-06, 4.32732122e-07, 1.68625422e-14, 2.78303816e-24, 4.57547401e-36, 6.29549366e-38, 6.51603786e-43, 0, 0, 0, 0, 0, 0,
+     0, 1.85738496e-35, 2.09622431e-23, 7.04194732e-15, 8.51207126e-16, 8.24994521e-24, 6.70895768e-34, 1.40129846e-45, 0, 0, 0, 0, 0, 0, 0, 0},
+};
+static const float GOLDEN_FLOAT_ABS_SUMS[GOLDEN_FIELDS] = {535.563049, 591.595337, 114.082596, 1479.35657, 1876.42993, 1444.2135};
+
+// Q16.16 velocity and pressure, Q8.8 colors
+static const float GOLDEN_FIXED_SAMPLES[GOLDEN_FIELDS][GOLDEN_SAMPLES] = {
+    {0.0131530762, -0.0229187012, 0.0335845947, -0.0188751221, 0.0291900635, -0.00810241699, 0.0174407959, -0.00770568848, 0.00759887695, -0.0015411377, -0.0061340332, 0.00381469727, -0.0189666748, 0.0104064941, -0.0173797607, 0.012802124,
+     0.0100402832, 0.0214233398, 0.0429382324, 0.0796203613, 0.0877380371, 0.0624542236, 0.0230712891, 0.0036315918, 0.00967407227, 0.000503540039, -0.0342559814, -0.0705108643, -0.056427002, -0.0330352783, -0.0127105713, -0.00631713867,
+     -0.00189208984, 0.0180053711, 0.0690155029, 0.171737671, 0.239044189, 0.129898071, 0.0188903809, -0.0402374268, 0.0455780029, 0.0252990723, -0.0437011719, -0.196762085, -0.123809814, -0.0476989746, -0.0159606934, -0.00285339355,
+     -0.0355377197, -0.0201263428, 0.0400390625, 0.19317627, 0.136276245, -0.0297851562, -0.0202789307, 0.32220459, 0.194580078, 0.200653076, 0.148620605, -0.560745239, -0.1381073, -0.0242767334, 0.000442504883, 0.00779724121,
+     -0.0812683105, -0.0976409912, -0.114242554, 1.09179688, -0.239151001, -0.165786743, -0.198471069, -0.164978027, 0.145111084, 0.24659729, -0.230255127, 0.478775024, 0.160324097, 0.0498352051, 0.0294189453, 0.0225067139,
+     -0.148635864, -0.174911499, -0.254470825, 2.41323853, -0.143127441, -0.203521729, -0.172866821, -0.0766143799, 0.0187683105, 0.0516204834, 0.0194854736, 0.190307617, 0.145935059, 0.0800628662, 0.0466461182, 0.0359039307,
+     -0.168212891, -0.192184448, -0.213378906, 2.93719482, -0.557418823, -0.252670288, -0.159133911, -0.0750732422, -0.0142974854, 0.0277099609, 0.057144165, 0.0936126709, 0.0949249268, 0.0686645508, 0.0510406494, 0.0386657715,
+     -0.179321289, -0.191116333, -0.167739868, 0.894683838, -0.0165710449, -0.239730835, -0.136077881, -0.0735931396, -0.021270752, 0.0130767822, 0.0389099121, 0.0587158203, 0.0604553223, 0.0546569824, 0.0431671143, 0.0385131836,
+     -0.16960144, -0.19342041, -0.3019104, 0.489822388, 0.258575439, -0.167160034, -0.106506348, -0.0551300049, -0.0209197998, 0.00633239746, 0.0257720947, 0.0367584229, 0.0422973633, 0.038772583, 0.0361175537, 0.031036377,
+     -0.125823975, -0.150115967, -0.222610474, 0.458084106, -0.0814971924, -0.105575562, -0.0586242676, -0.0352783203, -0.0128326416, 0.00372314453, 0.0158843994, 0.0247497559, 0.0270996094, 0.0282745361, 0.0252838135, 0.0249786377,
+     -0.0692443848, -0.0597839355, -0.00817871094, 0.26322937, 0.190734863, 0.0208587646, -0.0136108398, -0.0127868652, -0.00564575195, 0.00294494629, 0.0103149414, 0.0143890381, 0.0175476074, 0.0170440674, 0.0174560547, 0.0158691406,
+     -0.0240478516, -0.012878418, 0.0193023682, 0.0929260254, 0.078704834, 0.032119751, 0.00233459473, -0.000411987305, -0.00210571289, 0.00343322754, 0.00395202637, 0.00814819336, 0.00718688965, 0.00939941406, 0.00744628906, 0.00889587402},
+    {0.0131378174, 0.0102233887, -0.00180053711, -0.0340118408, -0.0762023926, -0.135940552, -0.148620605, -0.152740479, -0.143554688, -0.135375977, -0.114440918, -0.065612793, -0.0178527832, 0.0107269287, 0.019241333, 0.0103149414,
+     -0.0230102539, 0.0217895508, 0.0187835693, -0.019317627, -0.0964355469, -0.158309937, -0.179992676, -0.157608032, -0.142715454, -0.15246582, -0.133666992, -0.0751037598, -0.00469970703, 0.0245513916, 0.0258483887, 0.0177001953,
+     0.0336151123, 0.0430603027, 0.0690917969, 0.0450286865, -0.128845215, -0.167007446, -0.277099609, -0.113586426, -0.123443604, -0.189193726, -0.223739624, -0.0861053467, 0.0475616455, 0.0607452393, 0.0441436768, 0.0181274414,
+     -0.0186767578, 0.0805969238, 0.16973877, 0.192092896, 0.968048096, 1.86882019, 2.15216064, 1.94380188, 0.703659058, 0.4559021, 0.416061401, 0.260055542, 0.220565796, 0.116912842, 0.0603942871, 0.0298919678,
+     0.0288848877, 0.0935668945, 0.239105225, 0.218276978, -0.275497437, -0.152313232, -0.153503418, -0.227142334, 0.297943115, 0.566452026, 0.691223145, 0.35736084, 0.232818604, 0.118270874, 0.0631256104, 0.0242462158,
+     -0.00723266602, 0.0702362061, 0.192459106, 0.0302124023, -0.312866211, -0.200744629, -0.176620483, -0.208236694, -0.125473022, -0.0936279297, -0.103424072, -0.0652770996, 0.0602416992, 0.0683135986, 0.0450134277, 0.0238952637,
+     0.0163421631, 0.0265045166, -0.00616455078, 0.334579468, -0.271575928, -0.120056152, -0.107894897, -0.103088379, -0.0872344971, -0.0641937256, -0.0564422607, -0.0260925293, 0.0163574219, 0.032409668, 0.0281066895, 0.0126037598,
+     -0.00466918945, 0.0151977539, 0.0446014404, 0.295516968, 0.083480835, 0.0173034668, -0.0235595703, -0.0387573242, -0.0387878418, -0.0353240967, -0.025177002, -0.0108642578, 0.00741577148, 0.0168914795, 0.0158843994, 0.010848999,
+     4.57763672e-05, -0.014541626, 0.0487365723, 0.490386963, -0.309249878, 0.0751342773, 0.0404205322, 0.0117340088, -0.0030670166, -0.00770568848, -0.0066986084, -0.000778198242, 0.00633239746, 0.00999450684, 0.0101623535, 0.00468444824,
+     0.000335693359, -0.0733032227, -0.222442627, -0.696685791, 0.535598755, 0.178039551, 0.0855560303, 0.0452270508, 0.0215148926, 0.0108795166, 0.00598144531, 0.00602722168, 0.00715637207, 0.00830078125, 0.0068359375, 0.00517272949,
+     -0.0209655762, -0.0774841309, -0.180953979, -0.217514038, 0.21635437, 0.152633667, 0.0960388184, 0.0568084717, 0.0361633301, 0.0211791992, 0.0144500732, 0.0101318359, 0.00898742676, 0.00726318359, 0.00592041016, 0.00256347656,
+     0.0109558105, -0.0571136475, -0.0855712891, -0.0511779785, 0.0581207275, 0.0942687988, 0.0786132812, 0.0602874756, 0.0396575928, 0.0278167725, 0.0177764893, 0.0133056641, 0.00947570801, 0.00761413574, 0.00521850586, 0.00366210938},
+    {-0.0402526855, -0.03855896, -0.036026001, -0.0336456299, -0.0328216553, -0.0328674316, -0.0308227539, -0.027130127, -0.021484375, -0.0152282715, -0.0059967041, 0.00445556641, 0.0144348145, 0.0213470459, 0.0254974365, 0.0278320312,
+     -0.0383911133, -0.0364074707, -0.0340576172, -0.0300750732, -0.0315246582, -0.0317687988, -0.0321044922, -0.0260772705, -0.022567749, -0.0162963867, -0.00839233398, 0.00421142578, 0.0155487061, 0.0217590332, 0.026550293, 0.0274353027,
+     -0.0354919434, -0.0335693359, -0.0264129639, -0.0223083496, -0.0242462158, -0.0336151123, -0.0359039307, -0.0241699219, -0.0216064453, -0.0233459473, -0.0155944824, 0.00318908691, 0.0187988281, 0.0254821777, 0.026473999, 0.0289764404,
+     -0.0324859619, -0.0288696289, -0.0204925537, -0.00559997559, -0.00526428223, -0.0349121094, -0.0405273438, -0.0132904053, -0.0317230225, -0.0416412354, -0.0320739746, 0.000762939453, 0.0302124023, 0.0276947021, 0.0289001465, 0.02784729,
+     -0.0312042236, -0.0294799805, -0.0207519531, 0.00257873535, -0.0153961182, -0.0298309326, -0.0386810303, -0.0598602295, -0.00302124023, -0.0276184082, -0.0104064941, -0.00625610352, 0.0303955078, 0.0292053223, 0.0270690918, 0.028427124,
+     -0.0310668945, -0.0304870605, -0.0346679688, -0.0283813477, -0.0346832275, -0.0323028564, -0.0309906006, -0.0243835449, -0.0140075684, -0.00750732422, -0.00180053711, 0.00726318359, 0.0212554932, 0.0240783691, 0.0264892578, 0.0256652832,
+     -0.0283203125, -0.0307312012, -0.0332641602, -0.0375213623, -0.0673370361, -0.0346221924, -0.0216522217, -0.0150756836, -0.00727844238, -0.00148010254, 0.00440979004, 0.0116119385, 0.0176086426, 0.0224761963, 0.0230407715, 0.0249481201,
+     -0.0221405029, -0.0237884521, -0.0290679932, -0.00158691406, -0.0442962646, -0.0214385986, -0.0126953125, -0.00552368164, -9.15527344e-05, 0.00462341309, 0.00955200195, 0.013381958, 0.0180969238, 0.019821167, 0.0224456787, 0.0220336914,
+     -0.0109710693, -0.0156555176, -0.0302734375, -0.0800476074, -0.00524902344, -0.010345459, -0.00158691406, 0.0034942627, 0.00698852539, 0.0105438232, 0.0127716064, 0.0161437988, 0.0175018311, 0.0200805664, 0.02003479, 0.0215606689,
+     0.00424194336, 0.00219726562, -0.00721740723, -0.0461273193, -0.0322875977, 0.00407409668, 0.0105285645, 0.0122070312, 0.0143127441, 0.0147705078, 0.0168151855, 0.0170593262, 0.0189361572, 0.0187072754, 0.0201721191, 0.0193786621,
+     0.020111084, 0.0217895508, 0.027633667, 0.0558013916, 0.0442199707, 0.0280609131, 0.0218963623, 0.0210571289, 0.0191040039, 0.0196075439, 0.018447876, 0.0194244385, 0.0184783936, 0.0195159912, 0.0185546875, 0.0195159912,
+     0.0303497314, 0.0318145752, 0.0397033691, 0.0467224121, 0.0467681885, 0.0356903076, 0.0305175781, 0.0251464844, 0.0238037109, 0.0211486816, 0.0210723877, 0.0193634033, 0.0197906494, 0.0184783936, 0.0191650391, 0.0180511475},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     1, 1, 0.99609375, 0.04296875, 0.99609375, 1, 1, 0.98828125, 0.3125, 0, 0, 0, 0, 0, 0, 0,
+     1, 1, 1, 0.86328125, 0.9765625, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0,
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 0.625, 0, 0, 0, 0, 0, 0,
+     1, 1, 1, 0.97265625, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0.9375, 0, 0, 0, 0, 0,
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0.1875, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0.1875, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0.8046875, 1, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0.0078125, 0.86328125, 0.921875, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0.09765625, 0.88671875, 0.88671875, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 0.13671875, 1, 1, 1, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 0.6875, 1, 1, 1, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0.375, 1, 1, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0.0625, 1, 1, 1, 1, 1,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0.8125, 1, 1, 1, 1},
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0.8125, 0, 0, 0, 0,
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0.19921875, 0, 0, 0, 0, 0,
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 0.9921875, 0.140625, 0.08203125, 0, 0, 0, 0,
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 0.90234375, 0.11328125, 0.11328125, 0, 0, 0, 0,
+     1, 1, 1, 1, 1, 1, 1, 1, 0.86328125, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0.00390625, 0.9609375, 0.00390625, 0, 0, 0.01171875, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0.13671875, 0.0234375, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0.03125, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+};
+static const float GOLDEN_FIXED_ABS_SUMS[GOLDEN_FIELDS] = {535.272278, 591.440674, 113.862106, 1480.42969, 1877.52344, 1443.37109};
+
+#endif
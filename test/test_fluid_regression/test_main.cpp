@@ -0,0 +1,306 @@
+// Runs the fluid-simulation from the initial conditions of its setup(), with a scripted drag in place
+// of the touch screen, and checks the fields after a fixed number of frames against the snapshots in
+// golden.h. It also prints how long each operator of sim_routine takes per frame on this machine,
+// so that every change to the solver has a correctness and a speed baseline to compare against.
+//
+// Run with: pio test -e native -f test_fluid_regression -v
+//
+// If a change is meant to change the results, regenerate golden.h by building with
+// -DFLUID_WRITE_GOLDEN, which prints the new header instead of checking against the old one:
+//   PLATFORMIO_BUILD_FLAGS=-DFLUID_WRITE_GOLDEN pio test -e native -f test_fluid_regression -v
+
+#include <unity.h>
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include "Fixed.h"
+#include "Vector.h"
+#include "Field.h"
+#include "VectorField.h"
+#include "DoubleBuffer.h"
+#include "Backtrace.h"
+#include "operations.h"
+#include "golden.h"
+
+static const int N_ROWS = 60;
+static const int N_COLS = 80;
+static const float DT = 1 / 12.0;
+static const float SOR_OMEGA = 1.3; // as in sim_routine
+static const int SOR_ITERATIONS = 10;
+
+// A drag, as touch_routine would report it: in screen coordinates (x is j, y is i) and in cells/s.
+struct ScriptedTouch
+{
+  int frame;
+  int x, y;
+  float velocity_x, velocity_y;
+};
+
+// A stroke right across the upper middle, then one back down the left side.
+static const ScriptedTouch TOUCHES[] = {
+    {2, 20, 15, 150, 0}, {3, 27, 15, 150, 0}, {4, 35, 16, 150, 25}, {5, 42, 17, 150, 25},
+    {6, 50, 18, 150, 0}, {20, 15, 20, 0, 120}, {21, 15, 25, 0, 120}, {22, 16, 30, 25, 120},
+    {23, 17, 35, 25, 120}, {24, 17, 40, 0, 120},
+};
+static const int N_TOUCHES = sizeof(TOUCHES) / sizeof(TOUCHES[0]);
+
+enum Operator
+{
+  ADVECT_VELOCITY,
+  DIVERGENCE,
+  PRESSURE,
+  GRADIENT,
+  TRACE,
+  APPLY_COLORS,
+  N_OPERATORS
+};
+static const char *OPERATOR_NAMES[N_OPERATORS] = {"advect velocity", "divergence", "pressure (SOR x10)",
+                                                  "gradient", "trace colors", "apply colors (x3)"};
+
+template <class SCALAR_T, class DYE_T>
+struct Simulation
+{
+  DoubleBuffer<VectorField<SCALAR_T, N_ROWS, N_COLS>> velocityBuffer;
+  VectorField<SCALAR_T, N_ROWS, N_COLS> &velocity;
+  Field<SCALAR_T, N_ROWS, N_COLS> divergenceField, pressureField;
+  Field<DYE_T, N_ROWS, N_COLS> red, green, blue, colorScratch;
+  Backtrace colorBacktrace;
+  double operatorMicroseconds[N_OPERATORS];
+  int frame;
+
+  Simulation()
+      : velocityBuffer(NEGATIVE), velocity(*velocityBuffer.front()), divergenceField(DONTCARE),
+        pressureField(CLONE), red(CLONE), green(CLONE), blue(CLONE), colorScratch(CLONE),
+        colorBacktrace(N_ROWS, N_COLS) {}
+
+  // The same as setup(): still fluid, and the three color sectors smoothed with a 3x3 kernel
+  void init()
+  {
+    for (int i = 0; i < N_ROWS; i++)
+      for (int j = 0; j < N_COLS; j++)
+        velocity.set(i, j, {0, 0});
+    velocity.update_boundary();
+
+    const int center_i = N_ROWS / 2, center_j = N_COLS / 2;
+    for (int i = 0; i < N_ROWS; i++)
+    {
+      for (int j = 0; j < N_COLS; j++)
+      {
+        float x = i - center_i, y = j - center_j;
+        float x_rotated = y, y_rotated = -x;
+        float angle = atan2(y_rotated, x_rotated);
+
+        red.index(i, j) = (angle < -M_PI / 3) ? 1 : 0;
+        green.index(i, j) = (angle >= -M_PI / 3 && angle < M_PI / 3) ? 1 : 0;
+        blue.index(i, j) = (angle >= M_PI / 3) ? 1 : 0;
+      }
+    }
+
+    // in place, like setup() does it
+    float kernel[3][3] = {{1 / 16.0, 1 / 8.0, 1 / 16.0}, {1 / 8.0, 1 / 4.0, 1 / 8.0}, {1 / 16.0, 1 / 8.0, 1 / 16.0}};
+    for (int i = 0; i < N_ROWS; i++)
+    {
+      for (int j = 0; j < N_COLS; j++)
+      {
+        float smoothed_red = 0, smoothed_green = 0, smoothed_blue = 0;
+        for (int di = 0; di < 3; di++)
+        {
+          for (int dj = 0; dj < 3; dj++)
+          {
+            int ii = i + di, jj = j + dj;
+            if (ii > N_ROWS - 1)
+              ii = N_ROWS - 1;
+            if (jj > N_COLS - 1)
+              jj = N_COLS - 1;
+
+            smoothed_red += kernel[di][dj] * (float)red.index(ii, jj);
+            smoothed_green += kernel[di][dj] * (float)green.index(ii, jj);
+            smoothed_blue += kernel[di][dj] * (float)blue.index(ii, jj);
+          }
+        }
+        red.index(i, j) = smoothed_red;
+        green.index(i, j) = smoothed_green;
+        blue.index(i, j) = smoothed_blue;
+      }
+    }
+    red.update_boundary();
+    green.update_boundary();
+    blue.update_boundary();
+
+    for (int k = 0; k < N_OPERATORS; k++)
+      operatorMicroseconds[k] = 0;
+    frame = 0;
+  }
+
+  // The same steps as sim_routine, timing each operator
+  void step()
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    semilagrangian_advect(velocityBuffer.back(), &velocity, &velocity, DT);
+    velocityBuffer.swap();
+    lap(ADVECT_VELOCITY, &start);
+
+    for (int k = 0; k < N_TOUCHES; k++)
+    {
+      const ScriptedTouch &touch = TOUCHES[k];
+      if (touch.frame == frame) // see sim_routine about the swap
+        velocity.set(touch.y, touch.x, {SCALAR_T(touch.velocity_y), SCALAR_T(touch.velocity_x)});
+    }
+    velocity.update_boundary();
+    start = std::chrono::steady_clock::now();
+
+    divergence(&divergenceField, &velocity);
+    lap(DIVERGENCE, &start);
+    sor_pressure(&pressureField, &divergenceField, SOR_ITERATIONS, SOR_OMEGA);
+    lap(PRESSURE, &start);
+    gradient_and_subtract(&velocity, &pressureField);
+    lap(GRADIENT, &start);
+
+    colorBacktrace.trace(&velocity, DT);
+    lap(TRACE, &start);
+    colorBacktrace.apply(&colorScratch, &red);
+    red.swap(colorScratch);
+    colorBacktrace.apply(&colorScratch, &green);
+    green.swap(colorScratch);
+    colorBacktrace.apply(&colorScratch, &blue);
+    blue.swap(colorScratch);
+    lap(APPLY_COLORS, &start);
+
+    frame++;
+  }
+
+  void lap(Operator op, std::chrono::steady_clock::time_point *start)
+  {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    operatorMicroseconds[op] += std::chrono::duration<double, std::micro>(now - *start).count();
+    *start = now;
+  }
+
+  void printTimes(const char *name) const
+  {
+    double total = 0;
+    printf("%s, us/frame:", name);
+    for (int k = 0; k < N_OPERATORS; k++)
+    {
+      printf(" %s %.1f,", OPERATOR_NAMES[k], operatorMicroseconds[k] / frame);
+      total += operatorMicroseconds[k] / frame;
+    }
+    printf(" total %.1f\n", total);
+  }
+};
+
+typedef Simulation<float, float> FloatSimulation;
+typedef Simulation<q16_16_t, q8_8_t> FixedSimulation;
+
+// The snapshot of a field is its values every GOLDEN_STEP rows and columns, plus the sum of its
+// absolute values over the whole domain so that a change anywhere shows up.
+template <class T>
+static void snapshot(const Field<T, N_ROWS, N_COLS> &field, float *samples, float *abs_sum)
+{
+  double sum = 0;
+  for (int i = 0; i < N_ROWS; i++)
+  {
+    for (int j = 0; j < N_COLS; j++)
+    {
+      float value = (float)field.index(i, j);
+      sum += fabs(value);
+      if (i % GOLDEN_STEP == 0 && j % GOLDEN_STEP == 0)
+        samples[(i / GOLDEN_STEP) * GOLDEN_COLS + j / GOLDEN_STEP] = value;
+    }
+  }
+  *abs_sum = sum;
+}
+
+template <class SIMULATION_T>
+static void takeSnapshots(const SIMULATION_T &sim, float samples[GOLDEN_FIELDS][GOLDEN_SAMPLES], float abs_sums[GOLDEN_FIELDS])
+{
+  snapshot(sim.velocity.x, samples[0], &abs_sums[0]);
+  snapshot(sim.velocity.y, samples[1], &abs_sums[1]);
+  snapshot(sim.pressureField, samples[2], &abs_sums[2]);
+  snapshot(sim.red, samples[3], &abs_sums[3]);
+  snapshot(sim.green, samples[4], &abs_sums[4]);
+  snapshot(sim.blue, samples[5], &abs_sums[5]);
+}
+
+#ifdef FLUID_WRITE_GOLDEN
+static void printSnapshots(const char *name, float samples[GOLDEN_FIELDS][GOLDEN_SAMPLES], float abs_sums[GOLDEN_FIELDS])
+{
+  printf("static const float GOLDEN_%s_SAMPLES[GOLDEN_FIELDS][GOLDEN_SAMPLES] = {\n", name);
+  for (int field = 0; field < GOLDEN_FIELDS; field++)
+  {
+    printf("    {");
+    for (int k = 0; k < GOLDEN_SAMPLES; k++)
+      printf("%.9g%s", samples[field][k], (k < GOLDEN_SAMPLES - 1) ? ((k + 1) % GOLDEN_COLS == 0 ? ",\n     " : ", ") : "");
+    printf("},\n");
+  }
+  printf("};\nstatic const float GOLDEN_%s_ABS_SUMS[GOLDEN_FIELDS] = {", name);
+  for (int field = 0; field < GOLDEN_FIELDS; field++)
+    printf("%.9g%s", abs_sums[field], (field < GOLDEN_FIELDS - 1) ? ", " : "};\n");
+}
+#else
+// Checks the snapshots against golden ones. tolerances[field] is per sample, and the sum of
+// absolute values gets that times the number of cells.
+static void checkSnapshots(const float golden_samples[GOLDEN_FIELDS][GOLDEN_SAMPLES], const float golden_abs_sums[GOLDEN_FIELDS],
+                           float samples[GOLDEN_FIELDS][GOLDEN_SAMPLES], float abs_sums[GOLDEN_FIELDS], const float tolerances[GOLDEN_FIELDS])
+{
+  static const char *FIELD_NAMES[GOLDEN_FIELDS] = {"velocity x", "velocity y", "pressure", "red", "green", "blue"};
+  for (int field = 0; field < GOLDEN_FIELDS; field++)
+  {
+    float worst = 0;
+    for (int k = 0; k < GOLDEN_SAMPLES; k++)
+      worst = fmaxf(worst, fabsf(samples[field][k] - golden_samples[field][k]));
+    printf("  %s: worst sample difference %.6f, abs sum %.3f (golden %.3f)\n", FIELD_NAMES[field], worst,
+           abs_sums[field], golden_abs_sums[field]);
+
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(tolerances[field], 0, worst, FIELD_NAMES[field]);
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(tolerances[field] * N_ROWS * N_COLS, golden_abs_sums[field], abs_sums[field],
+                                     FIELD_NAMES[field]);
+  }
+}
+#endif
+
+template <class SIMULATION_T>
+static void runAndCheck(const char *name, const float golden_samples[GOLDEN_FIELDS][GOLDEN_SAMPLES],
+                        const float golden_abs_sums[GOLDEN_FIELDS], const float tolerances[GOLDEN_FIELDS])
+{
+  static SIMULATION_T sim;
+  sim.init();
+  for (int frame = 0; frame < GOLDEN_FRAMES; frame++)
+    sim.step();
+  sim.printTimes(name);
+
+  static float samples[GOLDEN_FIELDS][GOLDEN_SAMPLES], abs_sums[GOLDEN_FIELDS];
+  takeSnapshots(sim, samples, abs_sums);
+#ifdef FLUID_WRITE_GOLDEN
+  printSnapshots(name, samples, abs_sums);
+#else
+  checkSnapshots(golden_samples, golden_abs_sums, samples, abs_sums, tolerances);
+#endif
+}
+
+void test_float_matches_golden()
+{
+  // Different compilers and flags round floats differently (e.g. by fusing multiply-adds), and that
+  // grows over the frames, so the float run only has to come close.
+  static const float tolerances[GOLDEN_FIELDS] = {0.05, 0.05, 0.05, 0.005, 0.005, 0.005};
+  runAndCheck<FloatSimulation>("FLOAT", GOLDEN_FLOAT_SAMPLES, GOLDEN_FLOAT_ABS_SUMS, tolerances);
+}
+
+void test_fixed_matches_golden()
+{
+  // Fixed point is all integer arithmetic, so it comes out the same everywhere.
+  static const float tolerances[GOLDEN_FIELDS] = {0, 0, 0, 0, 0, 0};
+  runAndCheck<FixedSimulation>("FIXED", GOLDEN_FIXED_SAMPLES, GOLDEN_FIXED_ABS_SUMS, tolerances);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_float_matches_golden);
+  RUN_TEST(test_fixed_matches_golden);
+  return UNITY_END();
+}
@@ -0,0 +1,201 @@
+// Headless benchmark for the sand engine. Pours sand into a 2.8" sized grid following a few
+// scripted scenarios and reports, for each one:
+// - ns/grain/frame: time spent moving pixels divided by the live (not landed) pixels it updated
+// - peak live grains: the most live pixels seen in one frame
+// - allocs/frame: calls to operator new made while moving pixels
+// - settle ms/frame: time per frame after the brush is lifted, which drops towards nothing as
+//   the sand comes to rest and its chunks fall asleep
+//
+// Run with: pio test -e native -f test_sand_bench -v
+
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <unity.h>
+#include "SandEngine.h"
+
+static const int16_t SCALED_COLS = 160;
+static const int16_t SCALED_ROWS = 120;
+
+static unsigned long allocationCount = 0;
+
+void *operator new(size_t size)
+{
+  allocationCount++;
+  void *p = malloc(size);
+  if (p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+  free(p);
+}
+
+class NullDrawSink : public SandDrawSink
+{
+public:
+  void drawCell(int16_t x, int16_t y, uint16_t color, uint8_t aux) override {}
+  void clearCell(int16_t x, int16_t y) override {}
+};
+
+struct PourScenario
+{
+  const char *Name;
+  uint16_t PourFrames;   // Frames with the brush down.
+  uint16_t SettleFrames; // Frames after the brush is lifted.
+  int16_t InputWidth;
+  uint8_t PercentInputFill;
+  void (*getInput)(uint16_t frame, int16_t &inputX, int16_t &inputY);
+};
+
+static void centerPour(uint16_t frame, int16_t &inputX, int16_t &inputY)
+{
+  inputX = SCALED_COLS / 2;
+  inputY = SCALED_ROWS / 4;
+}
+
+static void sweepPour(uint16_t frame, int16_t &inputX, int16_t &inputY)
+{
+  // Back and forth across the top of the screen.
+  int16_t span = 2 * (SCALED_COLS - 1);
+  int16_t x = (frame * 3) % span;
+  inputX = x < SCALED_COLS ? x : span - x;
+  inputY = 10;
+}
+
+static void rainPour(uint16_t frame, int16_t &inputX, int16_t &inputY)
+{
+  // A wide brush jumping around, like several fingers on the screen.
+  static const int16_t xs[] = {20, 130, 75, 45, 105};
+  inputX = xs[frame % 5];
+  inputY = 5 + (frame % 7) * 3;
+}
+
+static const PourScenario scenarios[] = {
+    {"center pour", 600, 300, 10, 10, centerPour},
+    {"sweep pour", 900, 300, 10, 10, sweepPour},
+    {"heavy rain", 600, 300, 20, 30, rainPour},
+};
+
+static void runScenario(const PourScenario &scenario)
+{
+  NullDrawSink drawSink;
+  // Fixed seed, so every run pours exactly the same sand.
+  FastRandom random(12345);
+  SandEngine<SCALED_COLS, SCALED_ROWS> sand(drawSink);
+  TEST_ASSERT_TRUE(sand.begin());
+
+  uint32_t spawned = 0;
+  uint32_t peakLive = 0;
+  uint64_t liveGrainFrames = 0;
+  uint64_t moveNanos = 0;
+  uint64_t settleNanos = 0;
+  unsigned long moveAllocations = 0;
+  uint16_t frames = scenario.PourFrames + scenario.SettleFrames;
+
+  for (uint16_t frame = 0; frame < frames; frame++)
+  {
+    if (frame < scenario.PourFrames)
+    {
+      int16_t inputX, inputY;
+      scenario.getInput(frame, inputX, inputY);
+
+      int16_t halfInputWidth = scenario.InputWidth / 2;
+      for (int16_t i = -halfInputWidth; i <= halfInputWidth; ++i)
+        for (int16_t j = -halfInputWidth; j <= halfInputWidth; ++j)
+          if (random.nextBelow(100) < scenario.PercentInputFill && sand.spawn(inputX + i, inputY + j, 0xF800))
+            spawned++;
+    }
+
+    uint32_t live = sand.countLivePixels();
+    peakLive = std::max(peakLive, live);
+    liveGrainFrames += live;
+
+    unsigned long allocationsBefore = allocationCount;
+    auto start = std::chrono::steady_clock::now();
+
+    // Same stripe phases as the two core projects, with both workers run one after the other.
+    sand.beginFrame();
+    for (uint8_t phase = 0; phase < 2; phase++)
+    {
+      sand.moveStripes(phase, 0, 2, random);
+      sand.moveStripes(phase, 1, 2, random);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    moveAllocations += allocationCount - allocationsBefore;
+    uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    moveNanos += nanos;
+    if (frame >= scenario.PourFrames)
+      settleNanos += nanos;
+  }
+
+  // Every spawned pixel must still be somewhere on the grid.
+  uint32_t occupied = 0;
+  auto &grid = sand.getGrid();
+  for (int16_t y = 0; y < SCALED_ROWS; y++)
+    for (int16_t x = 0; x < SCALED_COLS; x++)
+      if (grid.getState(x, y) != GRID_STATE_EMPTY)
+        occupied++;
+
+  printf("%-12s frames: %5u, spawned: %6u, ns/grain/frame: %8.1f, peak live grains: %6u, allocs/frame: %6.2f, ms/frame: %6.3f, settle ms/frame: %6.4f\n",
+         scenario.Name, frames, spawned,
+         liveGrainFrames ? (double)moveNanos / liveGrainFrames : 0.0,
+         peakLive,
+         (double)moveAllocations / frames,
+         (double)moveNanos / frames / 1e6,
+         (double)settleNanos / scenario.SettleFrames / 1e6);
+
+  TEST_ASSERT_EQUAL_UINT32(spawned, occupied);
+  TEST_ASSERT_EQUAL_UINT32(0, moveAllocations);
+}
+
+void test_center_pour()
+{
+  runScenario(scenarios[0]);
+}
+
+void test_sweep_pour()
+{
+  runScenario(scenarios[1]);
+}
+
+void test_heavy_rain()
+{
+  runScenario(scenarios[2]);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_center_pour);
+  RUN_TEST(test_sweep_pour);
+  RUN_TEST(test_heavy_rain);
+  return UNITY_END();
+}
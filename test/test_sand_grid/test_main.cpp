@@ -0,0 +1,81 @@
+// Checks the column occupancy bits of the sand grid against a plain walk over the cells.
+//
+// Run with: pio test -e native -f test_sand_grid -v
+
+#include <unity.h>
+#include "SandGrid.h"
+#include "FastRandom.h"
+
+// Not a multiple of 32, so the last word of each column is only partly used.
+static const int16_t COLS = 8;
+static const int16_t ROWS = 100;
+
+static SandGrid<COLS, ROWS> grid;
+
+static int16_t findLowestEmptyRowByWalking(int16_t x, int16_t fromY, int16_t toY)
+{
+  for (int16_t y = toY; y >= fromY; y--)
+    if (grid.isEmpty(x, y))
+      return y;
+
+  return -1;
+}
+
+static void checkAllRanges()
+{
+  for (int16_t x = 0; x < COLS; x++)
+    for (int16_t fromY = 0; fromY < ROWS; fromY++)
+      for (int16_t toY = fromY - 1; toY < ROWS; toY++)
+        TEST_ASSERT_EQUAL_INT(findLowestEmptyRowByWalking(x, fromY, toY), grid.findLowestEmptyRow(x, fromY, toY));
+}
+
+void test_empty_and_full_columns()
+{
+  TEST_ASSERT_TRUE(grid.begin());
+  TEST_ASSERT_EQUAL_INT(ROWS - 1, grid.findLowestEmptyRow(0, 0, ROWS - 1));
+
+  for (int16_t y = 0; y < ROWS; y++)
+    grid.place(0, y, GRID_STATE_LANDED, 0, 1, 0, 0);
+
+  TEST_ASSERT_EQUAL_INT(-1, grid.findLowestEmptyRow(0, 0, ROWS - 1));
+  checkAllRanges();
+}
+
+void test_random_cells_and_moves()
+{
+  FastRandom random(12345);
+  grid.clear();
+
+  for (int i = 0; i < 300; i++)
+  {
+    int16_t x = random.nextBelow(COLS);
+    int16_t y = random.nextBelow(ROWS);
+    if (grid.isEmpty(x, y))
+      grid.place(x, y, GRID_STATE_FALLING, 0, 1, 0, 0);
+  }
+  checkAllRanges();
+
+  // Moving pixels around must keep the bits in step with the cells.
+  for (int i = 0; i < 300; i++)
+  {
+    int16_t fromX = random.nextBelow(COLS);
+    int16_t fromY = random.nextBelow(ROWS);
+    int16_t toX = random.nextBelow(COLS);
+    int16_t toY = random.nextBelow(ROWS);
+    if (!grid.isEmpty(fromX, fromY) && grid.isEmpty(toX, toY))
+      grid.move(fromX, fromY, toX, toY, 1, 0);
+  }
+  checkAllRanges();
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_and_full_columns);
+  RUN_TEST(test_random_cells_and_moves);
+  return UNITY_END();
+}